@@ -0,0 +1,973 @@
+// Benchmarks for sdoc. Build with:
+//   g++ -std=c++17 -O2 -pthread sdoc_bench.cpp -o sdoc_bench -lz
+// Run all benchmarks, or those whose name starts with one of the arguments:
+//   sdoc_bench [--defs=N] [--fields=N] [--desc=N] [--tags=N] [--categories=N]
+//              [--links=F] [--seed=N] [--json=FILE] [lex parse escape ...]
+// --json writes every measurement as a JSON array ("-" for stdout).
+#define SDOC_NO_MAIN
+#include "sdt_doc.cpp"
+
+#include <chrono>
+#include <filesystem>
+
+struct Rng {
+    uint64_t s;
+    explicit Rng(uint64_t seed) : s(seed * 6364136223846793005ULL + 1442695040888963407ULL) {}
+    uint32_t next() { s = s * 6364136223846793005ULL + 1442695040888963407ULL; return (uint32_t)(s >> 33); }
+    uint32_t below(uint32_t n) { return next() % n; }
+};
+
+// links is the fraction of types and links that name another def.
+struct Spec {
+    size_t defs = 20000, fields = 6, desc = 60, tags = 12, categories = 5;
+    double links = 0.5;
+    uint64_t seed = 1;
+};
+
+string makeCorpus(const Spec& spec) {
+    static const char* kinds[] = { "struct", "fn", "enum", "const", "class", "union", "type", "interface", "trait" };
+    static const char* builtins[] = { "int", "bool", "string", "float", "u64", "bytes" };
+    static const char* words[] = { "returns", "the", "value", "of", "a", "<markup>", "&", "\\\"quoted\\\"", "handle", "for", "user", "buffer" };
+    Rng rng(spec.seed);
+    uint32_t n = (uint32_t)max<size_t>(spec.defs, 1);
+    auto ref = [&](bool builtin) {
+        if (rng.below(1000) < spec.links * 1000) return "Item" + to_string(rng.below(n));
+        return builtin ? string(builtins[rng.below(6)]) : "\"external page " + to_string(rng.below(n)) + "\"";
+    };
+    string s;
+    for (size_t i = 0; i < spec.defs; i++) {
+        string name = "Item" + to_string(i);
+        string kind = kinds[rng.below(9)];
+        s += kind + " " + name + " {\n";
+        string desc = "Description of " + name;
+        while (desc.size() < spec.desc) desc += string(" ") + words[rng.below(12)];
+        s += "    desc: \"" + desc + "\";\n";
+        s += "    category: \"Cat" + to_string(rng.below((uint32_t)max<size_t>(spec.categories, 1))) + "\";\n";
+        s += "    since: \"1." + to_string(i % 7) + "\";\n";
+        if (spec.tags) {
+            s += "    tags: ";
+            for (uint32_t t = 0, k = 1 + rng.below(2); t < k; t++) s += (t ? ", tag" : "tag") + to_string(rng.below((uint32_t)spec.tags));
+            s += ";\n";
+        }
+        if (kind == "fn") s += "    returns: " + ref(true) + ";\n";
+        uint32_t fields = rng.below((uint32_t)spec.fields + 1);
+        for (uint32_t j = 0; j < fields; j++) {
+            s += "    " + ref(true) + "* f" + to_string(j) + " : \"field " + to_string(j) + "\" = 0;\n";
+        }
+        s += "    links: " + ref(false) + ";\n";
+        s += "}\n";
+    }
+    return s;
+}
+
+void resolveAll(vector<Def>& defs, Arena& arena) {
+    SymbolTable symbols(defs.size());
+    for (size_t i = 0; i < defs.size(); i++) symbols.insert(defs[i].name, (int32_t)i);
+    Resolver r(symbols, arena);
+    for (auto& d : defs) r.resolve(d);
+}
+
+double seconds(chrono::steady_clock::time_point t0) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+uintmax_t dirBytes(const string& dir) {
+    uintmax_t total = 0;
+    for (const auto& e : filesystem::directory_iterator(dir)) total += e.file_size();
+    return total;
+}
+
+size_t statusKB(const char* key) {
+    ifstream f("/proc/self/status");
+    string line;
+    while (getline(f, line)) {
+        if (line.compare(0, strlen(key), key) == 0) return stoul(line.substr(strlen(key) + 1));
+    }
+    return 0;
+}
+
+struct Result {
+    string name;
+    size_t defs = 0;
+    double seconds = 0;
+    uint64_t items = 0, bytes = 0;
+    vector<pair<string, double>> extra;
+};
+
+vector<Result> results;
+
+Result& record(const string& name, size_t defs, double t, uint64_t items, uint64_t bytes) {
+    results.push_back({ name, defs, t, items, bytes, {} });
+    return results.back();
+}
+
+void writeJson(const string& path, const Spec& spec) {
+    Out f;
+    char num[32];
+    auto real = [&](double v) { snprintf(num, sizeof num, "%.6g", v); return string_view(num); };
+    f << "{\"spec\": {\"defs\": " << spec.defs << ", \"fields\": " << spec.fields << ", \"desc\": " << spec.desc
+      << ", \"tags\": " << spec.tags << ", \"categories\": " << spec.categories << ", \"links\": " << real(spec.links)
+      << ", \"seed\": " << spec.seed << "},\n\"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        f << (i ? ",\n" : "\n") << "{\"name\": " << jsString(r.name) << ", \"defs\": " << r.defs << ", \"seconds\": " << real(r.seconds)
+          << ", \"items\": " << r.items << ", \"bytes\": " << r.bytes;
+        f << ", \"items_per_s\": " << real(r.items / r.seconds) << ", \"mb_per_s\": " << real(r.bytes / 1e6 / r.seconds);
+        for (const auto& e : r.extra) f << ", " << jsString(e.first) << ": " << real(e.second);
+        f << "}";
+    }
+    f << "\n]}\n";
+    if (path == "-") cout << f.str();
+    else f.save(path);
+}
+
+// Fastest of n runs of fn.
+template <class F> double best(int n, F fn) {
+    double t = 1e9;
+    for (int i = 0; i < n; i++) {
+        auto t0 = chrono::steady_clock::now();
+        fn();
+        t = min(t, seconds(t0));
+    }
+    return t;
+}
+
+void benchLex(const Spec& spec) {
+    string src = makeCorpus(spec);
+    size_t tokens = 0;
+    double t = best(5, [&] {
+        Arena arena;
+        Lexer lex(src, arena);
+        tokens = 0;
+        while (lex.next().type != TOK_EOF) tokens++;
+    });
+    cout << "lex " << spec.defs << " defs (" << src.size() / 1024 << " KB)\n";
+    printf("  %.3f s, %.0f Mtokens/s, %.0f MB/s\n", t, tokens / 1e6 / t, src.size() / 1e6 / t);
+    record("lex", spec.defs, t, tokens, src.size());
+}
+
+// One field tag per '@'; definition tags stop at the kind keyword.
+bool checkParse() {
+    const char* src = "@api, core struct Point {\n"
+                      "    desc: \"A point\";\n"
+                      "    @required @pos int x : \"x coord\" = 0;\n"
+                      "    float* y : \"y coord\";\n"
+                      "    @required, deprecated string z;\n"
+                      "    tags: extra;\n"
+                      "}\n";
+    auto list = [](Span<string_view> v) {
+        string s;
+        for (auto x : v) s += (s.empty() ? "" : ",") + string(x);
+        return s;
+    };
+    Arena arena;
+    vector<Def> defs;
+    try {
+        Parser p(src, arena);
+        defs = p.parse();
+    } catch (const exception&) {}
+    bool ok = defs.size() == 1 && defs[0].name == "Point" && list(defs[0].tags) == "api,core,extra" && defs[0].fields.size() == 3;
+    if (ok) {
+        const Field& x = defs[0].fields[0];
+        const Field& y = defs[0].fields[1];
+        const Field& z = defs[0].fields[2];
+        ok = x.type == "int" && x.name == "x" && x.desc == "x coord" && x.defval == "0" && x.required && list(x.tags) == "required,pos" &&
+             y.type == "float*" && y.name == "y" && y.desc == "y coord" && y.tags.empty() &&
+             z.type == "string" && z.name == "z" && z.required && list(z.tags) == "required,deprecated";
+    }
+    printf("  parse check: %s\n", ok ? "AST matches" : "AST differs");
+    return ok;
+}
+
+// The parser before the arena AST, over a string copy of the input, kept
+// for the peak-RSS comparison.
+namespace legacy {
+enum TokenType { TOK_EOF, TOK_ID, TOK_STR, TOK_NUM, TOK_LB, TOK_RB, TOK_SEMI, TOK_EQ, TOK_COLON, TOK_COMMA, TOK_AT };
+
+struct Token { TokenType type; string val; };
+
+class Lexer {
+    string src;
+    size_t pos = 0;
+    
+    unsigned char peek(int off = 0) const { return pos + off < src.size() ? src[pos + off] : 0; }
+    char get() { return pos < src.size() ? src[pos++] : 0; }
+    
+    void skip() {
+        while (peek()) {
+            if (isspace(peek())) { get(); continue; }
+            if (peek() == '#') { while (peek() && peek() != '\n') get(); continue; }
+            if (peek() == '/' && peek(1) == '/') { while (peek() && peek() != '\n') get(); continue; }
+            if (peek() == '/' && peek(1) == '*') {
+                get(); get();
+                while (peek() && !(peek() == '*' && peek(1) == '/')) get();
+                if (peek()) { get(); get(); }
+                continue;
+            }
+            break;
+        }
+    }
+    
+    string str() {
+        char q = get();
+        string s;
+        while (peek() && peek() != q) {
+            if (peek() == '\\' && peek(1)) { get(); s += get(); }
+            else s += get();
+        }
+        if (peek() == q) get();
+        return s;
+    }
+    
+public:
+    Lexer(const string& s) : src(s) {}
+    
+    Token next() {
+        skip();
+        if (!peek()) return {TOK_EOF, ""};
+        if (peek() == '"' || peek() == '\'') return {TOK_STR, str()};
+        if (peek() == '{') { get(); return {TOK_LB, "{"}; }
+        if (peek() == '}') { get(); return {TOK_RB, "}"}; }
+        if (peek() == ';') { get(); return {TOK_SEMI, ";"}; }
+        if (peek() == '=') { get(); return {TOK_EQ, "="}; }
+        if (peek() == ':') { get(); return {TOK_COLON, ":"}; }
+        if (peek() == ',') { get(); return {TOK_COMMA, ","}; }
+        if (peek() == '@') { get(); return {TOK_AT, "@"}; }
+        
+        if (isdigit(peek()) || (peek() == '-' && isdigit(peek(1)))) {
+            string s;
+            if (peek() == '-') s += get();
+            while (isdigit(peek())) s += get();
+            if (peek() == '.') { s += get(); while (isdigit(peek())) s += get(); }
+            return {TOK_NUM, s};
+        }
+        
+        string s;
+        while (peek() && (isalnum(peek()) || peek() == '_' || peek() == '*' || peek() == '&' || peek() == '<' || peek() == '>')) 
+            s += get();
+        return {TOK_ID, s};
+    }
+};
+
+struct Field {
+    string type, name, desc, defval;
+    vector<string> tags;
+    bool required = false;
+};
+
+struct Def {
+    string kind, name, desc, ret, category, version, author, since, deprecated;
+    vector<Field> fields;
+    vector<string> links, examples, notes, tags;
+    map<string, string> meta;
+};
+
+class Parser {
+    Lexer lex;
+    Token tok;
+    
+    void eat() { tok = lex.next(); }
+    bool match(TokenType t) { if (tok.type == t) { eat(); return true; } return false; }
+    bool match(const string& s) { if (tok.val == s) { eat(); return true; } return false; }
+    void expect(TokenType t) { if (!match(t)) throw runtime_error("Expected token, got: " + tok.val); }
+    
+    string type() {
+        string t;
+        while (tok.type == TOK_ID) {
+            t += tok.val;
+            eat();
+            if (tok.type == TOK_ID && (tok.val[0] == '*' || tok.val[0] == '&')) continue;
+            break;
+        }
+        return t;
+    }
+    
+    vector<string> tagList() {
+        vector<string> tags;
+        while (tok.type == TOK_ID || tok.type == TOK_STR) {
+            tags.push_back(tok.val);
+            eat();
+            match(TOK_COMMA);
+        }
+        return tags;
+    }
+    
+    string multilineValue() {
+        string val;
+        while (tok.type != TOK_SEMI && tok.type != TOK_RB && tok.type != TOK_EOF && tok.type != TOK_AT && tok.val != "links") {
+            if (!val.empty() && tok.type != TOK_COMMA) val += " ";
+            val += tok.val;
+            eat();
+        }
+        return val;
+    }
+    
+    Field field() {
+        Field f;
+        
+        if (match(TOK_AT)) {
+            f.tags = tagList();
+            for (const auto& t : f.tags) {
+                if (t == "required") f.required = true;
+            }
+        }
+        
+        f.type = type();
+        if (tok.type == TOK_ID) { f.name = tok.val; eat(); }
+        
+        if (match(TOK_COLON)) {
+            if (tok.type == TOK_STR) { 
+                f.desc = tok.val; 
+                eat(); 
+            } else {
+                f.desc = multilineValue();
+            }
+        }
+        
+        if (match(TOK_EQ)) {
+            if (tok.type == TOK_STR || tok.type == TOK_NUM || tok.type == TOK_ID) {
+                f.defval = tok.val; eat();
+            }
+        }
+        
+        match(TOK_SEMI);
+        return f;
+    }
+    
+public:
+    Parser(const string& s) : lex(s) { eat(); }
+    
+    vector<Def> parse() {
+        vector<Def> defs;
+        
+        while (tok.type != TOK_EOF) {
+            Def d;
+            
+            if (match(TOK_AT)) d.tags = tagList();
+            
+            if (tok.val == "struct" || tok.val == "union" || tok.val == "fn" || 
+                tok.val == "enum" || tok.val == "type" || tok.val == "const" || 
+                tok.val == "class" || tok.val == "interface" || tok.val == "trait") {
+                d.kind = tok.val; eat();
+            } else throw runtime_error("Expected type keyword");
+            
+            if (tok.type == TOK_ID) { d.name = tok.val; eat(); }
+            
+            expect(TOK_LB);
+            while (tok.type != TOK_RB && tok.type != TOK_EOF) {
+                if (match("desc") && match(TOK_COLON)) {
+                    if (tok.type == TOK_STR) {
+                        d.desc = tok.val;
+                        eat();
+                    } else {
+                        d.desc = multilineValue();
+                    }
+                    match(TOK_SEMI);
+                }
+                else if (match("returns") && match(TOK_COLON)) {
+                    d.ret = type();
+                    match(TOK_SEMI);
+                }
+                else if (match("links") && match(TOK_COLON)) {
+                    while (tok.type == TOK_ID || tok.type == TOK_STR) {
+                        d.links.push_back(tok.val); eat();
+                        match(TOK_COMMA);
+                    }
+                    match(TOK_SEMI);
+                }
+                else if (match("examples") && match(TOK_COLON)) {
+                    while (tok.type == TOK_STR) {
+                        d.examples.push_back(tok.val); eat();
+                        match(TOK_COMMA);
+                    }
+                    match(TOK_SEMI);
+                }
+                else if (match("notes") && match(TOK_COLON)) {
+                    while (tok.type == TOK_STR) {
+                        d.notes.push_back(tok.val); eat();
+                        match(TOK_COMMA);
+                    }
+                    match(TOK_SEMI);
+                }
+                else if (match("category") && match(TOK_COLON)) {
+                    if (tok.type == TOK_ID || tok.type == TOK_STR) {
+                        d.category = tok.val; eat();
+                    }
+                    match(TOK_SEMI);
+                }
+                else if (match("version") && match(TOK_COLON)) {
+                    if (tok.type == TOK_ID || tok.type == TOK_STR || tok.type == TOK_NUM) {
+                        d.version = tok.val; eat();
+                    }
+                    match(TOK_SEMI);
+                }
+                else if (match("author") && match(TOK_COLON)) {
+                    if (tok.type == TOK_ID || tok.type == TOK_STR) {
+                        d.author = tok.val; eat();
+                    }
+                    match(TOK_SEMI);
+                }
+                else if (match("since") && match(TOK_COLON)) {
+                    if (tok.type == TOK_ID || tok.type == TOK_STR || tok.type == TOK_NUM) {
+                        d.since = tok.val; eat();
+                    }
+                    match(TOK_SEMI);
+                }
+                else if (match("deprecated") && match(TOK_COLON)) {
+                    d.deprecated = (tok.type == TOK_STR) ? tok.val : "true";
+                    if (tok.type != TOK_SEMI) eat();
+                    match(TOK_SEMI);
+                }
+                else if (match("tags") && match(TOK_COLON)) {
+                    while (tok.type == TOK_ID || tok.type == TOK_STR) {
+                        d.tags.push_back(tok.val); eat(); match(TOK_COMMA);
+                    }
+                    match(TOK_SEMI);
+                }
+                else if (tok.type == TOK_ID) {
+                    string key = tok.val;
+                    eat();
+                    if (match(TOK_COLON)) {
+                        if (tok.type == TOK_STR || tok.type == TOK_ID || tok.type == TOK_NUM) {
+                            d.meta[key] = tok.val; eat();
+                        }
+                        match(TOK_SEMI);
+                    } else {
+                        d.fields.push_back(field());
+                    }
+                }
+                else eat();
+            }
+            expect(TOK_RB);
+            defs.push_back(d);
+        }
+        
+        return defs;
+    }
+};
+}
+
+// Resets VmHWM to the current RSS, so each parser reports its own peak.
+void resetPeak() { ofstream("/proc/self/clear_refs") << "5"; }
+
+void benchParse(const Spec& spec) {
+    if (!checkParse()) { cerr << "Error: parse result mismatch\n"; exit(1); }
+    string path = (filesystem::temp_directory_path() / "sdoc_bench.doc").string();
+    {
+        ofstream f(path);
+        f << makeCorpus(spec);
+    }
+    size_t n = spec.defs, bytes = 0;
+    cout << "parse " << n << " defs (" << filesystem::file_size(path) / 1024 << " KB input)\n";
+    auto report = [&](const char* name, const char* key, double t, size_t defs, size_t before, size_t after) {
+        size_t peak = statusKB("VmHWM");
+        printf("  %-8s %.3f s, %.0f defs/s, RSS +%zu KB (%.0f bytes/def incl. input), peak RSS %zu KB\n",
+               name, t, n / t, after - before, (after - before) * 1024.0 / n, peak);
+        record(key, n, t, defs, bytes).extra = { { "rss_bytes_per_def", (after - before) * 1024.0 / n }, { "peak_rss_kb", (double)peak } };
+    };
+    {
+        resetPeak();
+        size_t before = statusKB("VmRSS");
+        auto t0 = chrono::steady_clock::now();
+        MappedFile input(path);
+        bytes = input.view().size();
+        Arena arena;
+        Parser p(input.view(), arena);
+        auto defs = p.parse();
+        report("arena", "parse", seconds(t0), defs.size(), before, statusKB("VmRSS"));
+    }
+    {
+        resetPeak();
+        size_t before = statusKB("VmRSS");
+        auto t0 = chrono::steady_clock::now();
+        ifstream in(path);
+        stringstream buffer;
+        buffer << in.rdbuf();
+        string input = buffer.str();
+        legacy::Parser p(input);
+        auto defs = p.parse();
+        report("baseline", "parse.baseline", seconds(t0), defs.size(), before, statusKB("VmRSS"));
+    }
+    filesystem::remove(path);
+}
+
+// Later loads must reproduce the parsed AST.
+void benchCache(const Spec& spec) {
+    auto tmp = filesystem::temp_directory_path();
+    string path = (tmp / "sdoc_bench_cache.doc").string(), dir = (tmp / "sdoc_bench_cache").string();
+    {
+        ofstream f(path);
+        f << makeCorpus(spec);
+    }
+    size_t n = spec.defs;
+    filesystem::remove_all(dir);
+    auto time = [&](const string& cacheDir) { return best(5, [&] { parseSource(path, cacheDir); }); };
+    auto t0 = chrono::steady_clock::now();
+    auto parsed = parseSource(path, dir);
+    double write = seconds(t0);
+    auto cached = parseSource(path, dir);
+    bool same = parsed->defs.size() == cached->defs.size();
+    for (size_t i = 0; same && i < parsed->defs.size(); i++) {
+        const Def& a = parsed->defs[i];
+        const Def& b = cached->defs[i];
+        same = a.name == b.name && a.desc == b.desc && a.ret == b.ret && a.fields.size() == b.fields.size() && a.links.size() == b.links.size() &&
+               a.tags.size() == b.tags.size() && a.meta.size() == b.meta.size() && hashDef(a) == hashDef(b);
+    }
+    if (!same) {
+        cout << "cache load does not match the parsed AST\n";
+        exit(1);
+    }
+    double parse = time(""), load = time(dir);
+    cout << "cache " << n << " defs (" << parsed->file->view().size() / 1024 << " KB input, "
+         << cached->file->view().size() / 1024 << " KB .sdocb)\n";
+    printf("  cold parse %.3f s, parse + cache write %.3f s, cache load %.3f s (%.1fx)\n", parse, write, load, parse / load);
+    record("cache.parse", n, parse, n, parsed->file->view().size());
+    record("cache.write", n, write, n, cached->file->view().size());
+    record("cache.load", n, load, n, cached->file->view().size());
+    filesystem::remove_all(dir);
+    filesystem::remove(path);
+}
+
+string legacyLinkify(string_view type, const map<string_view, string>& nameMap) {
+    string result, current;
+    
+    for (char c : type) {
+        if (isalnum(c) || c == '_') {
+            current += c;
+        } else {
+            if (!current.empty()) {
+                result += nameMap.count(current) ? 
+                    "<a href=\"" + nameMap.at(current) + "\" class=\"type-link\">" + escape(current) + "</a>" :
+                    escape(current);
+                current.clear();
+            }
+            result += escape(string(1, c));
+        }
+    }
+    
+    if (!current.empty()) {
+        result += nameMap.count(current) ? 
+            "<a href=\"" + nameMap.at(current) + "\" class=\"type-link\">" + escape(current) + "</a>" :
+            escape(current);
+    }
+    
+    return result;
+}
+
+// The page writer before the buffered output layer, kept for comparison.
+void legacyPage(const Def& def, const map<string_view, string>& nameMap, const string& outdir, const Sidebar& nav) {
+    ofstream f(outdir + "/" + string(def.name) + ".html");
+    
+    f << "<!DOCTYPE html>\n<html lang=\"en\">\n<head>\n<meta charset=\"UTF-8\">\n<meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">\n";
+    f << "<title>" << escape(def.name) << " - SDOC Documentation</title>\n<style>\n" << getStyle() << "</style>\n</head>\n<body>\n";
+    f << "<div class=\"container\">\n<div class=\"two-column\">\n";
+    
+    if (nav.shared) {
+        f << "<div class=\"sidebar\" data-current=\"" << def.name << ".html\"><script src=\"nav.js\"></script></div>\n";
+    } else {
+        f << "<div class=\"sidebar\">\n";
+        size_t at = 0;
+        auto it = nav.current.find(def.name);
+        if (it != nav.current.end()) {
+            for (size_t off : it->second) {
+                f.write(nav.html.data() + at, off - at);
+                f << " class=\"current\"";
+                at = off;
+            }
+        }
+        f.write(nav.html.data() + at, nav.html.size() - at);
+        f << "</div>\n";
+    }
+    
+    f << "<div class=\"detail-page\">\n";
+    f << "<div class=\"detail-header\">\n";
+    f << "<div class=\"detail-title\">\n" << escape(def.name) << " <span class=\"badge badge-" << def.kind << "\">" << def.kind << "</span>\n";
+    if (!def.deprecated.empty()) f << "<span class=\"deprecated-badge\">deprecated</span>\n";
+    f << "</div>\n";
+    
+    if (!def.desc.empty()) f << "<div class=\"detail-desc\">" << escape(def.desc) << "</div>\n";
+    
+    if (!def.deprecated.empty() && def.deprecated != "true") {
+        f << "<div class=\"note-block\" style=\"border-left-color: #da3633; background: #2d1417;\">\n";
+        f << "<strong>⚠️ Deprecated:</strong> " << escape(def.deprecated) << "\n</div>\n";
+    }
+    
+    if (!def.category.empty() || !def.version.empty() || !def.author.empty() || !def.since.empty()) {
+        f << "<div class=\"meta-info\" style=\"margin-top: 15px;\">\n";
+        if (!def.category.empty()) f << "<span class=\"category-badge\">" << escape(def.category) << "</span>\n";
+        if (!def.version.empty()) f << "<span>Version: " << escape(def.version) << "</span>\n";
+        if (!def.since.empty()) f << "<span>Since: " << escape(def.since) << "</span>\n";
+        if (!def.author.empty()) f << "<span>Author: " << escape(def.author) << "</span>\n";
+        f << "</div>\n";
+    }
+    
+    if (!def.tags.empty()) {
+        f << "<div class=\"tags\" style=\"margin-top: 15px;\">\n";
+        for (const auto& t : def.tags) f << "<span class=\"tag\">" << escape(t) << "</span>\n";
+        f << "</div>\n";
+    }
+    
+    f << "</div>\n";
+    
+    if (!def.ret.empty()) {
+        f << "<div class=\"section\">\n<div class=\"section-title\">Returns</div>\n";
+        f << "<div class=\"returns-box\"><span class=\"type\">" << legacyLinkify(def.ret, nameMap) << "</span></div>\n</div>\n";
+    }
+    
+    if (!def.fields.empty()) {
+        f << "<div class=\"section\">\n<div class=\"section-title\">Fields</div>\n";
+        f << "<table class=\"field-table\">\n<thead>\n<tr><th>Name</th><th>Type</th><th>Description</th><th>Default</th></tr>\n</thead>\n<tbody>\n";
+        for (const auto& field : def.fields) {
+            f << "<tr>\n";
+            f << "<td><span class=\"name\">" << escape(field.name) << "</span>";
+            if (field.required) f << "<span class=\"required-badge\">REQUIRED</span>";
+            if (!field.tags.empty()) {
+                f << "<div class=\"tags\" style=\"margin-top: 5px;\">";
+                for (const auto& t : field.tags) f << "<span class=\"tag\">" << escape(t) << "</span> ";
+                f << "</div>";
+            }
+            f << "</td>\n";
+            f << "<td><span class=\"type\">" << legacyLinkify(field.type, nameMap) << "</span></td>\n";
+            f << "<td>" << escape(field.desc) << "</td>\n";
+            f << "<td>" << (field.defval.empty() ? "-" : "<span class=\"default\">" + escape(field.defval) + "</span>") << "</td>\n";
+            f << "</tr>\n";
+        }
+        f << "</tbody>\n</table>\n</div>\n";
+    }
+    
+    if (!def.examples.empty()) {
+        f << "<div class=\"section\">\n<div class=\"section-title\">Examples</div>\n";
+        for (const auto& ex : def.examples) {
+            f << "<div class=\"example-block\">\n<pre>" << escape(ex) << "</pre>\n</div>\n";
+        }
+        f << "</div>\n";
+    }
+    
+    if (!def.notes.empty()) {
+        f << "<div class=\"section\">\n<div class=\"section-title\">Notes</div>\n";
+        for (const auto& note : def.notes) {
+            f << "<div class=\"note-block\">💡 " << escape(note) << "</div>\n";
+        }
+        f << "</div>\n";
+    }
+    
+    if (!def.links.empty()) {
+        f << "<div class=\"section\">\n<div class=\"section-title\">Related Items</div>\n";
+        f << "<div class=\"links-grid\">\n";
+        for (const auto& link : def.links) {
+            f << "<div class=\"link-item\">";
+            if (nameMap.count(link)) {
+                f << "<a href=\"" << nameMap.at(link) << "\">" << escape(link) << "</a>";
+            } else {
+                f << escape(link);
+            }
+            f << "</div>\n";
+        }
+        f << "</div>\n</div>\n";
+    }
+    
+    if (!def.meta.empty()) {
+        f << "<div class=\"section\">\n<div class=\"section-title\">Additional Metadata</div>\n";
+        f << "<table class=\"field-table\">\n<tbody>\n";
+        for (const auto& m : def.meta) {
+            f << "<tr><td style=\"width: 200px;\"><strong>" << escape(m.first) << "</strong></td><td>" << escape(m.second) << "</td></tr>\n";
+        }
+        f << "</tbody>\n</table>\n</div>\n";
+    }
+    
+    f << "</div>\n</div>\n</div>\n</body>\n</html>\n";
+}
+
+void benchWriter(const Spec& spec) {
+    string src = makeCorpus(spec);
+    size_t n = spec.defs;
+    Arena arena;
+    Parser p(src, arena);
+    auto defs = p.parse();
+    map<string_view, string> nameMap;
+    for (const auto& d : defs) nameMap[d.name] = string(d.name) + ".html";
+    resolveAll(defs, arena);
+    Sidebar nav = buildSidebar(defs, true);
+    Style style = loadStyle("", false);
+    string outdir = (filesystem::temp_directory_path() / "sdoc_bench").string();
+    
+    cout << "page writer (" << n << " pages, nav=shared)\n";
+    for (int legacy = 1; legacy >= 0; legacy--) {
+        filesystem::remove_all(outdir);
+        filesystem::create_directories(outdir);
+        auto t0 = chrono::steady_clock::now();
+        for (const auto& d : defs) {
+            if (legacy) legacyPage(d, nameMap, outdir, nav);
+            else generatePage(d, outdir, nav, style);
+        }
+        double t = seconds(t0);
+        uintmax_t bytes = dirBytes(outdir);
+        printf("  %-9s %.3f s, %.1f MB, %.0f MB/s\n", legacy ? "ofstream" : "buffered", t, bytes / 1e6, bytes / 1e6 / t);
+        record(legacy ? "writer.ofstream" : "writer.buffered", n, t, defs.size(), bytes);
+    }
+    
+    Out out;
+    size_t bytes = 0;
+    auto t0 = chrono::steady_clock::now();
+    for (const auto& d : defs) {
+        for (const auto& f : d.fields) { out.clear(); out << esc(f.desc) << linkify(f.typeRefs); bytes += out.size(); }
+        out.clear();
+        out << esc(d.desc);
+        bytes += out.size();
+    }
+    double t1 = seconds(t0);
+    size_t legacyBytes = 0;
+    t0 = chrono::steady_clock::now();
+    for (const auto& d : defs) {
+        for (const auto& f : d.fields) legacyBytes += escape(f.desc).size() + legacyLinkify(f.type, nameMap).size();
+        legacyBytes += escape(d.desc).size();
+    }
+    double t2 = seconds(t0);
+    printf("  escape+linkify only: temporaries %.0f MB/s, in place %.0f MB/s\n", legacyBytes / 1e6 / t2, bytes / 1e6 / t1);
+    filesystem::remove_all(outdir);
+}
+
+// Linkifying every return and field type, without the rest of the page.
+void benchLinkify(const Spec& spec) {
+    string src = makeCorpus(spec);
+    Arena arena;
+    Parser p(src, arena);
+    auto defs = p.parse();
+    resolveAll(defs, arena);
+    Out out;
+    size_t types = 0;
+    double t = best(5, [&] {
+        out.clear();
+        types = 0;
+        for (const auto& d : defs) {
+            out << linkify(d.retRefs);
+            for (const auto& f : d.fields) out << linkify(f.typeRefs);
+            types += 1 + d.fields.size();
+        }
+    });
+    cout << "linkify " << types << " types\n";
+    printf("  %.3f s, %.0f ns/type, %.0f MB/s out\n", t, t * 1e9 / types, out.size() / 1e6 / t);
+    record("linkify", spec.defs, t, types, out.size());
+}
+
+// Rendering pages into memory, without writing them.
+void benchRenderPage(const Spec& spec, bool sharedNav) {
+    string src = makeCorpus(spec);
+    Arena arena;
+    Parser p(src, arena);
+    auto defs = p.parse();
+    resolveAll(defs, arena);
+    Sidebar nav = buildSidebar(defs, sharedNav);
+    Style style = loadStyle("", true);
+    Out out;
+    size_t bytes = 0;
+    double t = best(3, [&] {
+        bytes = 0;
+        for (const auto& d : defs) {
+            out.clear();
+            renderPage(out, d, nav, style);
+            bytes += out.size();
+        }
+    });
+    string name = string("render.page.nav=") + (sharedNav ? "shared" : "inline");
+    cout << name << " " << defs.size() << " pages\n";
+    printf("  %.3f s, %.2f us/page, %.0f bytes/page, %.0f MB/s\n", t, t * 1e6 / defs.size(), (double)bytes / defs.size(), bytes / 1e6 / t);
+    record(name, spec.defs, t, defs.size(), bytes);
+}
+
+void benchRender(const Spec& spec, bool sharedNav, bool sharedCss) {
+    string name = string("render.site.nav=") + (sharedNav ? "shared" : "inline") + ",css=" + (sharedCss ? "shared" : "inline");
+    cout << name << "\n";
+    cout << "  defs      seconds   us/def    bytes/def\n";
+    for (size_t n : { spec.defs / 8, spec.defs / 4, spec.defs / 2, spec.defs }) {
+        Spec s = spec;
+        s.defs = max<size_t>(n, 1);
+        string src = makeCorpus(s);
+        Arena arena;
+        Parser p(src, arena);
+        auto defs = p.parse();
+        resolveAll(defs, arena);
+
+        string outdir = (filesystem::temp_directory_path() / "sdoc_bench").string();
+        filesystem::remove_all(outdir);
+        filesystem::create_directories(outdir);
+
+        auto t0 = chrono::steady_clock::now();
+        Sidebar nav = buildSidebar(defs, sharedNav);
+        Style style = loadStyle("", sharedCss);
+        if (nav.shared) generateNav(nav, outdir);
+        if (sharedCss) writeStyle(style, outdir);
+        generateIndex(defs, outdir, style);
+        generateSearchIndex(defs, outdir);
+        for (const auto& d : defs) generatePage(d, outdir, nav, style);
+        double t = seconds(t0);
+
+        uintmax_t bytes = dirBytes(outdir);
+        printf("  %-8zu  %-8.3f  %-7.1f  %zu\n", s.defs, t, t * 1e6 / s.defs, (size_t)(bytes / s.defs));
+        record(name, s.defs, t, s.defs + 1, bytes);
+        filesystem::remove_all(outdir);
+    }
+}
+
+string legacyEscape(string_view s) {
+    string r;
+    for (char c : s) {
+        switch(c) {
+            case '<': r += "&lt;"; break;
+            case '>': r += "&gt;"; break;
+            case '&': r += "&amp;"; break;
+            case '"': r += "&quot;"; break;
+            case '\'': r += "&#39;"; break;
+            default: r += c;
+        }
+    }
+    return r;
+}
+
+vector<pair<const char*, FindSpecial>> escapeKernels() {
+    vector<pair<const char*, FindSpecial>> k = { { "scalar", findSpecialScalar } };
+#if defined(__x86_64__)
+    k.push_back({ "sse2", findSpecialSSE2 });
+    if (__builtin_cpu_supports("avx2")) k.push_back({ "avx2", findSpecialAVX2 });
+#endif
+    return k;
+}
+
+bool checkEscape() {
+    static const char alphabet[] = "ab <>&\"'x\n\t\x80\xff";
+    Rng rng(7);
+    vector<string> cases = { "", "<", "plain", string(100, '&'), "<<>>&&\"\"''" };
+    for (size_t len = 1; len <= 80; len++) {
+        for (size_t at = 0; at < len; at++) {
+            string s(len, 'a');
+            s[at] = "<>&\"'"[at % 5];
+            cases.push_back(s);
+        }
+        for (int r = 0; r < 50; r++) {
+            string s;
+            for (size_t i = 0; i < len; i++) s += alphabet[rng.below(sizeof alphabet - 1)];
+            cases.push_back(s);
+        }
+    }
+    bool ok = true;
+    for (const auto& k : escapeKernels()) {
+        size_t bad = 0;
+        for (const auto& c : cases) {
+            string r = "prefix";
+            appendEscaped(r, c, k.second);
+            if (r != "prefix" + legacyEscape(c)) bad++;
+        }
+        printf("  %-6s %zu/%zu cases match the reference escape()\n", k.first, cases.size() - bad, cases.size());
+        ok = ok && bad == 0;
+    }
+    return ok;
+}
+
+void benchEscape() {
+    cout << "escape kernels\n";
+    if (!checkEscape()) { cerr << "Error: escape kernel mismatch\n"; exit(1); }
+    Rng rng(3);
+    for (int every : { 80, 8 }) {
+        string text;
+        while (text.size() < (32 << 20)) {
+            text += rng.below(every) == 0 ? "<>&\"'"[rng.below(5)] : (char)('a' + rng.below(26));
+            if (rng.below(12) == 0) text += ' ';
+        }
+        cout << "  one special per ~" << every << " bytes\n";
+        auto t0 = chrono::steady_clock::now();
+        size_t bytes = legacyEscape(text).size();
+        double t = seconds(t0);
+        printf("    %-8s %6.0f MB/s\n", "legacy", text.size() / 1e6 / t);
+        record("escape.legacy.every" + to_string(every), 0, t, text.size(), text.size());
+        string out;
+        out.reserve(bytes);
+        for (const auto& k : escapeKernels()) {
+            out.clear();
+            t0 = chrono::steady_clock::now();
+            appendEscaped(out, text, k.second);
+            t = seconds(t0);
+            printf("    %-8s %6.0f MB/s\n", k.first, text.size() / 1e6 / t);
+            record(string("escape.") + k.first + ".every" + to_string(every), 0, t, text.size(), text.size());
+        }
+    }
+}
+
+// main's pipeline on 8 files; the second build finds the manifest and writes nothing.
+void benchPipeline(const Spec& spec) {
+    auto tmp = filesystem::temp_directory_path();
+    string indir = (tmp / "sdoc_bench_in").string(), outdir = (tmp / "sdoc_bench_out").string();
+    filesystem::remove_all(indir);
+    filesystem::remove_all(outdir);
+    filesystem::create_directories(indir);
+    filesystem::create_directories(outdir);
+    string src = makeCorpus(spec);
+    for (size_t k = 0, at = 0; k < 8; k++) {
+        size_t end = k == 7 ? src.size() : src.find("\n}\n", max(at, src.size() * (k + 1) / 8));
+        end = end == string::npos ? src.size() : min(src.size(), end + 3);
+        ofstream(indir + "/part" + to_string(k) + ".doc") << src.substr(at, end - at);
+        at = end;
+    }
+    
+    Options opt;
+    opt.sharedNav = opt.sharedCss = true;
+    opt.jobs = max(1u, thread::hardware_concurrency());
+    ThreadPool pool(opt.jobs);
+    cout << "pipeline " << spec.defs << " defs, 8 files, " << opt.jobs << " threads\n";
+    for (const char* phase : { "cold", "noop" }) {
+        auto t0 = chrono::steady_clock::now();
+        Corpus corpus = loadCorpus(expandInputs({ indir }), pool);
+        Style style = loadStyle("", opt.sharedCss);
+        Manifest manifest = Manifest::load(outdir);
+        size_t rewritten = build(corpus, opt, style, outdir, manifest, pool);
+        double t = seconds(t0);
+        printf("  %-4s %.3f s, %zu pages written\n", phase, t, rewritten);
+        record(string("pipeline.") + phase, spec.defs, t, rewritten, src.size());
+    }
+    filesystem::remove_all(indir);
+    filesystem::remove_all(outdir);
+}
+
+int main(int argc, char** argv) {
+    Spec spec;
+    string json;
+    vector<string> only;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        size_t eq = a.find('=');
+        string key = a.substr(0, eq), val = eq == string::npos ? "" : a.substr(eq + 1);
+        if (key == "--defs") spec.defs = stoul(val);
+        else if (key == "--fields") spec.fields = stoul(val);
+        else if (key == "--desc") spec.desc = stoul(val);
+        else if (key == "--tags") spec.tags = stoul(val);
+        else if (key == "--categories") spec.categories = stoul(val);
+        else if (key == "--links") spec.links = stod(val);
+        else if (key == "--seed") spec.seed = stoull(val);
+        else if (key == "--json") json = val;
+        else if (a[0] == '-') { cerr << "Error: Unknown option '" << a << "'\n"; return 1; }
+        else only.push_back(a);
+    }
+    auto want = [&](const string& name) {
+        if (only.empty()) return true;
+        for (const auto& o : only) if (name.compare(0, o.size(), o) == 0) return true;
+        return false;
+    };
+    // Human-readable output goes to stderr when the JSON goes to stdout.
+    int out = dup(1);
+    if (json == "-") dup2(2, 1);
+    
+    if (want("escape")) benchEscape();
+    if (want("lex")) benchLex(spec);
+    if (want("parse")) benchParse(spec);
+    if (want("cache")) benchCache(spec);
+    if (want("linkify")) benchLinkify(spec);
+    if (want("render.page")) { benchRenderPage(spec, false); benchRenderPage(spec, true); }
+    if (want("render.site")) { benchRender(spec, false, false); benchRender(spec, true, false); benchRender(spec, true, true); }
+    if (want("writer")) benchWriter(spec);
+    if (want("pipeline")) benchPipeline(spec);
+    
+    cout.flush();
+    fflush(stdout);
+    dup2(out, 1);
+    if (!json.empty()) writeJson(json, spec);
+    return 0;
+}
@@ -1,3 +1,5 @@
+// Build with:
+//   g++ -std=c++17 -O2 -pthread sdt_doc.cpp -o sdoc -lz
 #include <iostream>
 #include <string>
 #include <vector>
@@ -5,136 +7,494 @@
 #include <sstream>
 #include <map>
 #include <set>
+#include <list>
 #include <algorithm>
 #include <cctype>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <memory_resource>
+#include <unordered_set>
+#include <filesystem>
+#include <charconv>
+#include <cerrno>
+#include <csignal>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <zlib.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
-enum TokenType { TOK_EOF, TOK_ID, TOK_STR, TOK_NUM, TOK_LB, TOK_RB, TOK_SEMI, TOK_EQ, TOK_COLON, TOK_COMMA, TOK_AT };
+enum TokenType : uint8_t { TOK_EOF, TOK_ID, TOK_STR, TOK_NUM, TOK_LB, TOK_RB, TOK_SEMI, TOK_EQ, TOK_COLON, TOK_COMMA, TOK_AT };
 
-struct Token { TokenType type; string val; };
+// Keywords are only reserved where the parser expects them; elsewhere they lex as TOK_ID.
+enum Keyword : uint8_t {
+    KW_NONE,
+    KW_STRUCT, KW_UNION, KW_FN, KW_ENUM, KW_TYPE, KW_CONST, KW_CLASS, KW_INTERFACE, KW_TRAIT,
+    KW_DESC, KW_RETURNS, KW_LINKS, KW_EXAMPLES, KW_NOTES, KW_CATEGORY, KW_VERSION, KW_AUTHOR, KW_SINCE, KW_DEPRECATED, KW_TAGS,
+    KW_COUNT
+};
+
+constexpr string_view keywordNames[KW_COUNT] = {
+    "",
+    "struct", "union", "fn", "enum", "type", "const", "class", "interface", "trait",
+    "desc", "returns", "links", "examples", "notes", "category", "version", "author", "since", "deprecated", "tags",
+};
+
+inline bool isKind(Keyword k) { return k >= KW_STRUCT && k <= KW_TRAIT; }
+
+// Perfect hash of the keywords into 32 slots, from length, first and last byte.
+constexpr size_t keywordSlot(string_view s) {
+    return (s.size() * 6 + static_cast<unsigned char>(s[0]) * 15 + (static_cast<unsigned char>(s[s.size() - 1]) << 1)) & 31;
+}
+
+struct KeywordTable {
+    Keyword slots[32] = {};
+    bool perfect = true;
+    
+    constexpr KeywordTable() {
+        for (uint8_t k = 1; k < KW_COUNT; k++) {
+            size_t i = keywordSlot(keywordNames[k]);
+            if (slots[i] != KW_NONE) perfect = false;
+            slots[i] = static_cast<Keyword>(k);
+        }
+    }
+};
+
+constexpr KeywordTable keywordTable;
+static_assert(keywordTable.perfect, "keywordSlot() maps two keywords to the same slot");
+
+inline Keyword keyword(string_view s) {
+    if (s.size() < 2 || s.size() > 10) return KW_NONE;
+    Keyword k = keywordTable.slots[keywordSlot(s)];
+    return keywordNames[k] == s ? k : KW_NONE;
+}
+
+struct Token { TokenType type; string_view val; Keyword kw = KW_NONE; };
+
+struct Lane {
+    struct Event { const char* name; int64_t start, dur; };
+    
+    size_t id = 0;
+    vector<Event> events;
+    uint64_t filesIn = 0, bytesIn = 0, tokens = 0, filesOut = 0, bytesOut = 0, allocs = 0, allocBytes = 0;
+    
+    void addCounters(const Lane& o) {
+        filesIn += o.filesIn;
+        bytesIn += o.bytesIn;
+        tokens += o.tokens;
+        filesOut += o.filesOut;
+        bytesOut += o.bytesOut;
+        allocs += o.allocs;
+        allocBytes += o.allocBytes;
+    }
+};
+
+// Instrumentation for --stats and --trace; threads record into their own Lane without locking.
+class Stats {
+    static inline mutex m;
+    static inline vector<unique_ptr<Lane>> lanes;
+    static inline chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+    
+public:
+    static inline bool on = false;
+    
+    static void enable() {
+        on = true;
+        epoch = chrono::steady_clock::now();
+    }
+    
+    static int64_t now() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count();
+    }
+    
+    static Lane& lane() {
+        thread_local Lane* self = nullptr;
+        if (!self) {
+            lock_guard<mutex> l(m);
+            lanes.push_back(make_unique<Lane>());
+            self = lanes.back().get();
+            self->id = lanes.size() - 1;
+        }
+        return *self;
+    }
+    
+    static void report(ostream& out);
+    static void saveTrace(const string& path);
+};
+
+// Times the enclosing scope as one event on the calling thread's lane.
+class Phase {
+    const char* name;
+    int64_t start = -1;
+    
+public:
+    explicit Phase(const char* n) : name(n) { if (Stats::on) start = Stats::now(); }
+    ~Phase() { if (start >= 0) Stats::lane().events.push_back({ name, start, Stats::now() - start }); }
+    Phase(const Phase&) = delete;
+    Phase& operator=(const Phase&) = delete;
+};
+
+class MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    string fallback;
+    
+public:
+    explicit MappedFile(const string& path) {
+        Phase phase("read");
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw runtime_error("Cannot open input file '" + path + "'");
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, st.st_size, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(p);
+                size = st.st_size;
+                mapped = true;
+            }
+        }
+        if (!mapped) {
+            char buf[65536];
+            ssize_t n;
+            while ((n = read(fd, buf, sizeof buf)) > 0) fallback.append(buf, n);
+            data = fallback.data();
+            size = fallback.size();
+        }
+        close(fd);
+        if (Stats::on) {
+            Lane& lane = Stats::lane();
+            lane.filesIn++;
+            lane.bytesIn += size;
+        }
+    }
+    
+    ~MappedFile() { if (mapped) munmap(const_cast<char*>(data), size); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    string_view view() const { return string_view(data, size); }
+};
+
+template <class T> struct Span {
+    const T* ptr = nullptr;
+    size_t len = 0;
+    
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + len; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+};
+
+class Arena : public pmr::memory_resource {
+    vector<unique_ptr<char[]>> blocks;
+    char* cur = nullptr;
+    size_t left = 0;
+    size_t last = 0;
+    size_t next = 64 * 1024;
+    
+    void* do_allocate(size_t n, size_t align) override {
+        if (Stats::on) {
+            Lane& lane = Stats::lane();
+            lane.allocs++;
+            lane.allocBytes += n;
+        }
+        size_t pad = (align - reinterpret_cast<uintptr_t>(cur) % align) % align;
+        if (pad + n > left) {
+            size_t size = max(next, n + align);
+            blocks.push_back(make_unique<char[]>(size));
+            cur = blocks.back().get();
+            left = last = size;
+            next = min<size_t>(next * 2, 16 * 1024 * 1024);
+            pad = (align - reinterpret_cast<uintptr_t>(cur) % align) % align;
+        }
+        void* p = cur + pad;
+        cur += pad + n;
+        left -= pad + n;
+        return p;
+    }
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const pmr::memory_resource& o) const noexcept override { return this == &o; }
+    
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    
+    char* alloc(size_t n) { return static_cast<char*>(allocate(n ? n : 1, 1)); }
+    
+    // Releases everything allocated so far but keeps the newest block for reuse.
+    void reset() {
+        if (blocks.empty()) return;
+        if (blocks.size() > 1) {
+            blocks.front() = move(blocks.back());
+            blocks.resize(1);
+        }
+        cur = blocks.front().get();
+        left = last;
+    }
+    
+    string_view copy(string_view s) {
+        char* p = alloc(s.size());
+        if (!s.empty()) memcpy(p, s.data(), s.size());
+        return string_view(p, s.size());
+    }
+    
+    template <class T> Span<T> list(const vector<T>& v) {
+        if (v.empty()) return {};
+        T* p = static_cast<T*>(allocate(v.size() * sizeof(T), alignof(T)));
+        uninitialized_copy(v.begin(), v.end(), p);
+        return { p, v.size() };
+    }
+};
+
+class Interner {
+    Arena& arena;
+    pmr::unordered_set<string_view> table;
+    
+public:
+    explicit Interner(Arena& a) : arena(a), table(&a) {}
+    
+    string_view intern(string_view s) {
+        auto it = table.find(s);
+        if (it != table.end()) return *it;
+        return *table.insert(arena.copy(s)).first;
+    }
+};
+
+enum CharClass : uint8_t { CC_SPACE = 1, CC_DIGIT = 2, CC_IDENT = 4, CC_QUOTE = 8 };
+
+struct CharTable {
+    uint8_t cls[256] = {};
+    TokenType punct[256] = {};
+    
+    constexpr CharTable() {
+        for (int c : { ' ', '\t', '\n', '\v', '\f', '\r' }) cls[c] = CC_SPACE;
+        for (int c = '0'; c <= '9'; c++) cls[c] = CC_DIGIT | CC_IDENT;
+        for (int c = 'a'; c <= 'z'; c++) cls[c] = cls[c - 'a' + 'A'] = CC_IDENT;
+        for (int c : { '_', '*', '&', '<', '>' }) cls[c] = CC_IDENT;
+        cls[int('"')] = cls[int('\'')] = CC_QUOTE;
+        punct[int('{')] = TOK_LB;
+        punct[int('}')] = TOK_RB;
+        punct[int(';')] = TOK_SEMI;
+        punct[int('=')] = TOK_EQ;
+        punct[int(':')] = TOK_COLON;
+        punct[int(',')] = TOK_COMMA;
+        punct[int('@')] = TOK_AT;
+    }
+};
+
+constexpr CharTable chars;
 
 class Lexer {
-    string src;
+    string_view src;
     size_t pos = 0;
+    size_t count = 0;
+    Arena& arena;
     
-    char peek(int off = 0) const { return pos + off < src.size() ? src[pos + off] : 0; }
+    static bool is(char c, uint8_t cls) { return chars.cls[static_cast<unsigned char>(c)] & cls; }
+    char peek(size_t off = 0) const { return pos + off < src.size() ? src[pos + off] : 0; }
     char get() { return pos < src.size() ? src[pos++] : 0; }
     
+    void toEol() {
+        const void* nl = memchr(src.data() + pos, '\n', src.size() - pos);
+        pos = nl ? static_cast<const char*>(nl) - src.data() : src.size();
+    }
+    
     void skip() {
-        while (peek()) {
-            if (isspace(peek())) { get(); continue; }
-            if (peek() == '#') { while (peek() && peek() != '\n') get(); continue; }
-            if (peek() == '/' && peek(1) == '/') { while (peek() && peek() != '\n') get(); continue; }
-            if (peek() == '/' && peek(1) == '*') {
-                get(); get();
-                while (peek() && !(peek() == '*' && peek(1) == '/')) get();
-                if (peek()) { get(); get(); }
+        while (pos < src.size()) {
+            char c = src[pos];
+            if (is(c, CC_SPACE)) { pos++; continue; }
+            if (c == '#' || (c == '/' && peek(1) == '/')) { toEol(); continue; }
+            if (c == '/' && peek(1) == '*') {
+                size_t end = src.find("*/", pos + 2);
+                pos = end == string_view::npos ? src.size() : end + 2;
                 continue;
             }
             break;
         }
     }
     
-    string str() {
+    // Slice of the input unless the string has escapes.
+    string_view str() {
         char q = get();
-        string s;
+        size_t start = pos;
+        while (peek() && peek() != q && peek() != '\\') get();
+        if (peek() != '\\') {
+            string_view s = src.substr(start, pos - start);
+            if (peek() == q) get();
+            return s;
+        }
+        size_t end = pos;
+        while (end < src.size() && src[end] != q) end += (src[end] == '\\' && end + 1 < src.size()) ? 2 : 1;
+        char* out = arena.alloc(end - start);
+        size_t n = pos - start;
+        memcpy(out, src.data() + start, n);
         while (peek() && peek() != q) {
-            if (peek() == '\\' && peek(1)) { get(); s += get(); }
-            else s += get();
+            if (peek() == '\\' && peek(1)) get();
+            out[n++] = get();
         }
         if (peek() == q) get();
-        return s;
+        return string_view(out, n);
     }
     
 public:
-    Lexer(const string& s) : src(s) {}
+    Lexer(string_view s, Arena& a) : src(s), arena(a) {}
+    
+    size_t tokens() const { return count; }
     
     Token next() {
         skip();
-        if (!peek()) return {TOK_EOF, ""};
-        if (peek() == '"' || peek() == '\'') return {TOK_STR, str()};
-        if (peek() == '{') { get(); return {TOK_LB, "{"}; }
-        if (peek() == '}') { get(); return {TOK_RB, "}"}; }
-        if (peek() == ';') { get(); return {TOK_SEMI, ";"}; }
-        if (peek() == '=') { get(); return {TOK_EQ, "="}; }
-        if (peek() == ':') { get(); return {TOK_COLON, ":"}; }
-        if (peek() == ',') { get(); return {TOK_COMMA, ","}; }
-        if (peek() == '@') { get(); return {TOK_AT, "@"}; }
+        if (pos >= src.size() || src[pos] == 0) return {TOK_EOF, ""};
+        count++;
+        char c = src[pos];
+        size_t start = pos;
+        if (TokenType t = chars.punct[static_cast<unsigned char>(c)]) { pos++; return {t, src.substr(start, 1)}; }
+        if (is(c, CC_QUOTE)) return {TOK_STR, str()};
         
-        if (isdigit(peek()) || (peek() == '-' && isdigit(peek(1)))) {
-            string s;
-            if (peek() == '-') s += get();
-            while (isdigit(peek())) s += get();
-            if (peek() == '.') { s += get(); while (isdigit(peek())) s += get(); }
-            return {TOK_NUM, s};
+        if (is(c, CC_DIGIT) || (c == '-' && is(peek(1), CC_DIGIT))) {
+            pos++;
+            while (pos < src.size() && is(src[pos], CC_DIGIT)) pos++;
+            if (peek() == '.') { pos++; while (pos < src.size() && is(src[pos], CC_DIGIT)) pos++; }
+            return {TOK_NUM, src.substr(start, pos - start)};
         }
         
-        string s;
-        while (peek() && (isalnum(peek()) || peek() == '_' || peek() == '*' || peek() == '&' || peek() == '<' || peek() == '>')) 
-            s += get();
-        return {TOK_ID, s};
+        while (pos < src.size() && is(src[pos], CC_IDENT)) pos++;
+        if (pos == start) pos++;
+        string_view id = src.substr(start, pos - start);
+        return {TOK_ID, id, keyword(id)};
     }
 };
 
+// sym is the index in Corpus::defs, or < 0 for plain text.
+struct TypeToken {
+    string_view text;
+    int32_t sym = -1;
+};
+
 struct Field {
-    string type, name, desc, defval;
-    vector<string> tags;
+    string_view type, name, desc, defval;
+    Span<string_view> tags;
+    Span<TypeToken> typeRefs;
     bool required = false;
 };
 
 struct Def {
-    string kind, name, desc, ret, category, version, author, since, deprecated;
-    vector<Field> fields;
-    vector<string> links, examples, notes, tags;
-    map<string, string> meta;
+    string_view kind, name, desc, ret, category, version, author, since, deprecated;
+    Span<Field> fields;
+    Span<string_view> links, examples, notes, tags;
+    Span<pair<string_view, string_view>> meta;
+    Span<TypeToken> retRefs;
+    Span<int32_t> linkRefs;
+};
+
+struct Entry {
+    string_view kind, name, category;
+    uint32_t file = 0;
 };
 
 class Parser {
+    Arena& arena;
+    Interner strings;
     Lexer lex;
-    Token tok;
+    Token tok, ahead;
+    bool hasAhead = false;
+    vector<Field> fields;
+    vector<string_view> links, examples, notes, tags, fieldTags;
+    vector<pair<string_view, string_view>> meta;
+    
+    void eat() {
+        if (hasAhead) { tok = ahead; hasAhead = false; }
+        else tok = lex.next();
+    }
+    
+    // Read on demand, so a definition boundary still holds nothing but tok.
+    const Token& peekNext() {
+        if (!hasAhead) { ahead = lex.next(); hasAhead = true; }
+        return ahead;
+    }
     
-    void eat() { tok = lex.next(); }
     bool match(TokenType t) { if (tok.type == t) { eat(); return true; } return false; }
-    bool match(const string& s) { if (tok.val == s) { eat(); return true; } return false; }
-    void expect(TokenType t) { if (!match(t)) throw runtime_error("Expected token, got: " + tok.val); }
+    void expect(TokenType t) { if (!match(t)) throw runtime_error("Expected token, got: " + string(tok.val)); }
+    
+    void setMeta(string_view key, string_view val) {
+        auto it = lower_bound(meta.begin(), meta.end(), key, [](const auto& m, string_view k) { return m.first < k; });
+        if (it != meta.end() && it->first == key) it->second = val;
+        else meta.emplace(it, key, val);
+    }
     
-    string type() {
+    string_view type() {
+        string_view first;
         string t;
+        int parts = 0;
         while (tok.type == TOK_ID) {
-            t += tok.val;
+            if (parts++ == 0) first = tok.val;
+            else { if (parts == 2) t = first; t += tok.val; }
             eat();
-            if (tok.type == TOK_ID && (tok.val[0] == '*' || tok.val[0] == '&')) continue;
+            if (tok.type == TOK_ID && !tok.val.empty() && (tok.val[0] == '*' || tok.val[0] == '&')) continue;
             break;
         }
-        return t;
+        return strings.intern(parts > 1 ? string_view(t) : first);
     }
     
-    vector<string> tagList() {
-        vector<string> tags;
-        while (tok.type == TOK_ID || tok.type == TOK_STR) {
-            tags.push_back(tok.val);
+    void tagList(vector<string_view>& out) {
+        while ((tok.type == TOK_ID && !isKind(tok.kw)) || tok.type == TOK_STR) {
+            out.push_back(strings.intern(tok.val));
             eat();
             match(TOK_COMMA);
         }
-        return tags;
     }
     
-    string multilineValue() {
+    string_view multilineValue() {
+        string_view first;
         string val;
-        while (tok.type != TOK_SEMI && tok.type != TOK_RB && tok.type != TOK_EOF && tok.type != TOK_AT && tok.val != "links") {
-            if (!val.empty() && tok.type != TOK_COMMA) val += " ";
-            val += tok.val;
+        int parts = 0;
+        while (tok.type != TOK_SEMI && tok.type != TOK_RB && tok.type != TOK_EOF && tok.type != TOK_AT && tok.kw != KW_LINKS) {
+            if (parts++ == 0) first = tok.val;
+            else {
+                if (parts == 2) val = first;
+                if (!val.empty() && tok.type != TOK_COMMA) val += " ";
+                val += tok.val;
+            }
             eat();
         }
-        return val;
+        return parts > 1 ? arena.copy(val) : first;
     }
     
     Field field() {
         Field f;
         
-        if (match(TOK_AT)) {
-            f.tags = tagList();
+        if (tok.type == TOK_AT) {
+            fieldTags.clear();
+            while (match(TOK_AT)) {
+                do {
+                    if (tok.type == TOK_ID || tok.type == TOK_STR) { fieldTags.push_back(strings.intern(tok.val)); eat(); }
+                } while (match(TOK_COMMA));
+            }
+            f.tags = arena.list(fieldTags);
             for (const auto& t : f.tags) {
                 if (t == "required") f.required = true;
             }
@@ -163,177 +523,1285 @@ class Parser {
     }
     
 public:
-    Parser(const string& s) : lex(s) { eat(); }
+    Parser(string_view s, Arena& a) : arena(a), strings(a), lex(s, a) { eat(); }
+    
+    Parser(string_view s, Arena& a, Arena& vocab) : arena(a), strings(vocab), lex(s, a) { eat(); }
+    
+    size_t tokens() const { return lex.tokens(); }
     
     vector<Def> parse() {
         vector<Def> defs;
+        Def d;
+        while (next(d)) defs.push_back(d);
+        return defs;
+    }
+    
+    bool next(Def& d) {
+        if (tok.type == TOK_EOF) return false;
+        d = Def();
+        fields.clear(); links.clear(); examples.clear(); notes.clear(); tags.clear(); meta.clear();
         
-        while (tok.type != TOK_EOF) {
-            Def d;
-            
-            if (match(TOK_AT)) d.tags = tagList();
-            
-            if (tok.val == "struct" || tok.val == "union" || tok.val == "fn" || 
-                tok.val == "enum" || tok.val == "type" || tok.val == "const" || 
-                tok.val == "class" || tok.val == "interface" || tok.val == "trait") {
-                d.kind = tok.val; eat();
-            } else throw runtime_error("Expected type keyword");
-            
-            if (tok.type == TOK_ID) { d.name = tok.val; eat(); }
-            
-            expect(TOK_LB);
-            while (tok.type != TOK_RB && tok.type != TOK_EOF) {
-                if (match("desc") && match(TOK_COLON)) {
-                    if (tok.type == TOK_STR) {
-                        d.desc = tok.val;
-                        eat();
-                    } else {
-                        d.desc = multilineValue();
-                    }
-                    match(TOK_SEMI);
-                }
-                else if (match("returns") && match(TOK_COLON)) {
+        if (match(TOK_AT)) tagList(tags);
+        
+        if (!isKind(tok.kw)) throw runtime_error("Expected type keyword");
+        d.kind = strings.intern(tok.val); eat();
+        
+        if (tok.type == TOK_ID) { d.name = tok.val; eat(); }
+        
+        expect(TOK_LB);
+        while (tok.type != TOK_RB && tok.type != TOK_EOF) {
+            if (tok.type == TOK_ID && peekNext().type == TOK_COLON) {
+                Keyword kw = tok.kw;
+                string_view key = tok.val;
+                eat(); eat();
+                switch (kw) {
+                case KW_DESC:
+                    if (tok.type == TOK_STR) { d.desc = tok.val; eat(); }
+                    else d.desc = multilineValue();
+                    break;
+                case KW_RETURNS:
                     d.ret = type();
-                    match(TOK_SEMI);
-                }
-                else if (match("links") && match(TOK_COLON)) {
+                    break;
+                case KW_LINKS:
                     while (tok.type == TOK_ID || tok.type == TOK_STR) {
-                        d.links.push_back(tok.val); eat();
+                        links.push_back(tok.val); eat();
                         match(TOK_COMMA);
                     }
-                    match(TOK_SEMI);
-                }
-                else if (match("examples") && match(TOK_COLON)) {
+                    break;
+                case KW_EXAMPLES:
                     while (tok.type == TOK_STR) {
-                        d.examples.push_back(tok.val); eat();
+                        examples.push_back(tok.val); eat();
                         match(TOK_COMMA);
                     }
-                    match(TOK_SEMI);
-                }
-                else if (match("notes") && match(TOK_COLON)) {
+                    break;
+                case KW_NOTES:
                     while (tok.type == TOK_STR) {
-                        d.notes.push_back(tok.val); eat();
+                        notes.push_back(tok.val); eat();
                         match(TOK_COMMA);
                     }
-                    match(TOK_SEMI);
-                }
-                else if (match("category") && match(TOK_COLON)) {
+                    break;
+                case KW_CATEGORY:
                     if (tok.type == TOK_ID || tok.type == TOK_STR) {
-                        d.category = tok.val; eat();
+                        d.category = strings.intern(tok.val); eat();
                     }
-                    match(TOK_SEMI);
-                }
-                else if (match("version") && match(TOK_COLON)) {
+                    break;
+                case KW_VERSION:
                     if (tok.type == TOK_ID || tok.type == TOK_STR || tok.type == TOK_NUM) {
-                        d.version = tok.val; eat();
+                        d.version = strings.intern(tok.val); eat();
                     }
-                    match(TOK_SEMI);
-                }
-                else if (match("author") && match(TOK_COLON)) {
+                    break;
+                case KW_AUTHOR:
                     if (tok.type == TOK_ID || tok.type == TOK_STR) {
-                        d.author = tok.val; eat();
+                        d.author = strings.intern(tok.val); eat();
                     }
-                    match(TOK_SEMI);
-                }
-                else if (match("since") && match(TOK_COLON)) {
+                    break;
+                case KW_SINCE:
                     if (tok.type == TOK_ID || tok.type == TOK_STR || tok.type == TOK_NUM) {
-                        d.since = tok.val; eat();
+                        d.since = strings.intern(tok.val); eat();
                     }
-                    match(TOK_SEMI);
-                }
-                else if (match("deprecated") && match(TOK_COLON)) {
+                    break;
+                case KW_DEPRECATED:
                     d.deprecated = (tok.type == TOK_STR) ? tok.val : "true";
                     if (tok.type != TOK_SEMI) eat();
-                    match(TOK_SEMI);
-                }
-                else if (match("tags") && match(TOK_COLON)) {
+                    break;
+                case KW_TAGS:
                     while (tok.type == TOK_ID || tok.type == TOK_STR) {
-                        d.tags.push_back(tok.val); eat(); match(TOK_COMMA);
+                        tags.push_back(strings.intern(tok.val)); eat(); match(TOK_COMMA);
+                    }
+                    break;
+                default:
+                    if (tok.type == TOK_STR || tok.type == TOK_ID || tok.type == TOK_NUM) {
+                        setMeta(strings.intern(key), tok.val); eat();
                     }
-                    match(TOK_SEMI);
                 }
-                else if (tok.type == TOK_ID) {
-                    string key = tok.val;
-                    eat();
-                    if (match(TOK_COLON)) {
-                        if (tok.type == TOK_STR || tok.type == TOK_ID || tok.type == TOK_NUM) {
-                            d.meta[key] = tok.val; eat();
+                match(TOK_SEMI);
+            }
+            else if (tok.type == TOK_ID || tok.type == TOK_AT) fields.push_back(field());
+            else eat();
+        }
+        expect(TOK_RB);
+        d.fields = arena.list(fields);
+        d.links = arena.list(links);
+        d.examples = arena.list(examples);
+        d.notes = arena.list(notes);
+        d.tags = arena.list(tags);
+        d.meta = arena.list(meta);
+        return true;
+    }
+};
+
+// Doxygen comments (/** */, /*! */, ///) and the declarations that follow them.
+class HeaderScanner {
+    struct Doc {
+        string brief, text, returns, since, deprecated, author, version, category;
+        vector<pair<string, string>> params, meta;
+        vector<string> notes, links, tags;
+        bool present = false;
+    };
+
+    string_view src;
+    size_t pos = 0;
+    Arena& arena;
+    Interner strings;
+    vector<Def> defs;
+    vector<Field> fields;
+    vector<string_view> links, notes, tags;
+    vector<pair<string_view, string_view>> meta;
+
+    static bool identChar(char c) { return isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+    char peek(size_t off = 0) const { return pos + off < src.size() ? src[pos + off] : 0; }
+    bool at(string_view s) const { return src.compare(pos, s.size(), s) == 0; }
+
+    void skipLine() { while (pos < src.size() && src[pos] != '\n') pos++; }
+    void skipBlock() { size_t e = src.find("*/", pos + 2); pos = e == string_view::npos ? src.size() : e + 2; }
+    void skipLiteral() {
+        char q = src[pos++];
+        while (pos < src.size() && src[pos] != q) pos += src[pos] == '\\' ? 2 : 1;
+        pos = min(pos + 1, src.size());
+    }
+    void skipDirective() {
+        while (pos < src.size() && src[pos] != '\n') pos += (src[pos] == '\\' && peek(1) == '\n') ? 2 : 1;
+    }
+
+    bool atDocBlock() const { return (at("/**") && !at("/**/")) || at("/*!"); }
+    bool atDocLine() const { return (at("///") && !at("////")) || at("//!"); }
+    bool atTrailingDoc() const { return at("///<") || at("//!<") || at("/**<") || at("/*!<"); }
+
+    string readComment() {
+        string text;
+        auto addLine = [&](string_view line) {
+            size_t b = line.find_first_not_of(" \t\r");
+            if (b != string_view::npos && line[b] == '*') line.remove_prefix(b + 1);
+            text.append(line.data(), line.size());
+            text += '\n';
+        };
+        if (at("/*")) {
+            size_t e = src.find("*/", pos + 3);
+            if (e == string_view::npos) e = src.size();
+            string_view body = src.substr(pos + 3, e - pos - 3);
+            if (!body.empty() && body[0] == '<') body.remove_prefix(1);
+            pos = min(e + 2, src.size());
+            for (size_t i = 0; i <= body.size();) {
+                size_t nl = body.find('\n', i);
+                if (nl == string_view::npos) nl = body.size();
+                addLine(body.substr(i, nl - i));
+                i = nl + 1;
+            }
+            return text;
+        }
+        bool trailing = atTrailingDoc();
+        while (atDocLine() || atTrailingDoc()) {
+            pos += at("///<") || at("//!<") ? 4 : 3;
+            size_t start = pos;
+            skipLine();
+            text.append(src.data() + start, pos - start);
+            text += '\n';
+            size_t next = pos;
+            while (next < src.size() && isspace(static_cast<unsigned char>(src[next]))) next++;
+            size_t save = pos;
+            pos = next;
+            if (trailing || !atDocLine() || atTrailingDoc()) { pos = save; break; }
+        }
+        return text;
+    }
+
+    static string trim(string_view s) {
+        size_t b = s.find_first_not_of(" \t\r\n");
+        if (b == string_view::npos) return "";
+        size_t e = s.find_last_not_of(" \t\r\n");
+        return string(s.substr(b, e - b + 1));
+    }
+
+    static void append(string& to, const string& s) {
+        if (s.empty()) return;
+        if (!to.empty()) to += ' ';
+        to += s;
+    }
+
+    static Doc parseDoc(const string& text) {
+        Doc doc;
+        doc.present = true;
+        string cmd, arg, para;
+        bool inBrief = false;
+        auto flush = [&]() {
+            string body = trim(para);
+            para.clear();
+            if (cmd.empty()) {
+                if (inBrief || (doc.brief.empty() && doc.text.empty())) append(doc.brief, body);
+                else append(doc.text, body);
+                return;
+            }
+            if (cmd == "brief" || cmd == "short") append(doc.brief, body);
+            else if (cmd == "param") doc.params.emplace_back(arg, body);
+            else if (cmd == "return" || cmd == "returns" || cmd == "retval") append(doc.returns, body);
+            else if (cmd == "since") doc.since = body;
+            else if (cmd == "deprecated") doc.deprecated = body.empty() ? "true" : body;
+            else if (cmd == "author") append(doc.author, body);
+            else if (cmd == "version") doc.version = body;
+            else if (cmd == "ingroup") doc.category = body;
+            else if (cmd == "note" || cmd == "warning" || cmd == "remark") doc.notes.push_back(body);
+            else if (cmd == "see" || cmd == "sa") {
+                for (size_t i = 0; i < body.size();) {
+                    size_t e = body.find_first_of(", \t\n", i);
+                    if (e == string::npos) e = body.size();
+                    if (e > i) doc.links.push_back(body.substr(i, e - i));
+                    i = e + 1;
+                }
+            }
+            else if (cmd == "tags") {
+                for (size_t i = 0; i < body.size();) {
+                    size_t e = body.find_first_of(", \t\n", i);
+                    if (e == string::npos) e = body.size();
+                    if (e > i) doc.tags.push_back(body.substr(i, e - i));
+                    i = e + 1;
+                }
+            }
+            else if (cmd != "file" && cmd != "defgroup" && cmd != "addtogroup" && cmd != "{" && cmd != "}") {
+                doc.meta.emplace_back(cmd, body);
+            }
+        };
+
+        vector<string> lines;
+        for (size_t i = 0; i < text.size();) {
+            size_t nl = text.find('\n', i);
+            if (nl == string::npos) nl = text.size();
+            string line = trim(string_view(text).substr(i, nl - i));
+            i = nl + 1;
+            size_t at;
+            while ((at = line.find(" @", 1)) != string::npos && at + 2 < line.size() && isalpha(static_cast<unsigned char>(line[at + 2]))) {
+                lines.push_back(trim(string_view(line).substr(0, at)));
+                line = line.substr(at + 1);
+            }
+            lines.push_back(line);
+        }
+        for (const auto& line : lines) {
+            if (line.empty()) {
+                if (!para.empty() || !cmd.empty()) { flush(); cmd.clear(); inBrief = false; }
+                continue;
+            }
+            if (line[0] == '@' || line[0] == '\\') {
+                flush();
+                size_t e = 1;
+                while (e < line.size() && (identChar(line[e]) || line[e] == '{' || line[e] == '}')) e++;
+                cmd = line.substr(1, e - 1);
+                inBrief = cmd == "brief" || cmd == "short";
+                if (e < line.size() && line[e] == '[') {
+                    size_t close = line.find(']', e);
+                    if (close != string::npos) e = close + 1;
+                }
+                string rest = trim(string_view(line).substr(e));
+                if (cmd == "param") {
+                    size_t s = rest.find_first_of(" \t");
+                    arg = rest.substr(0, s);
+                    rest = s == string::npos ? "" : trim(string_view(rest).substr(s));
+                }
+                para = rest;
+                continue;
+            }
+            if (!para.empty()) para += ' ';
+            para += line;
+        }
+        flush();
+        return doc;
+    }
+
+    // Skips whitespace and non-doc comments; stops at doc comments and code.
+    void skipTrivia() {
+        while (pos < src.size()) {
+            if (isspace(static_cast<unsigned char>(src[pos]))) pos++;
+            else if (atDocBlock() || atDocLine()) return;
+            else if (at("//")) skipLine();
+            else if (at("/*")) skipBlock();
+            else return;
+        }
+    }
+
+    // Up to a ';' or '{' at paren depth 0, or a ',' or '}' for enumerators.
+    char declaration(vector<string_view>& toks, bool enumerator = false) {
+        toks.clear();
+        int depth = 0;
+        while (pos < src.size()) {
+            char c = src[pos];
+            if (isspace(static_cast<unsigned char>(c))) { pos++; continue; }
+            if (at("//")) { if (atTrailingDoc()) return 0; skipLine(); continue; }
+            if (at("/*")) { if (atTrailingDoc()) return 0; skipBlock(); continue; }
+            if (c == '#' && toks.empty()) { skipDirective(); continue; }
+            if (depth == 0) {
+                if (enumerator && (c == ',' || c == '}')) { if (c == ',') pos++; return c; }
+                if (!enumerator && (c == ';' || c == '{' || c == '}')) { if (c != '}') pos++; return c; }
+            }
+            size_t start = pos;
+            if (c == '"' || c == '\'') skipLiteral();
+            else if (isdigit(static_cast<unsigned char>(c))) { while (pos < src.size() && (identChar(src[pos]) || src[pos] == '.')) pos++; }
+            else if (identChar(c)) { while (pos < src.size() && identChar(src[pos])) pos++; }
+            else if (at("::") || at("->")) pos += 2;
+            else if (at("...")) pos += 3;
+            else {
+                if (c == '(' || c == '[' || (c == '{' && depth > 0)) depth++;
+                if ((c == ')' || c == ']' || c == '}') && depth > 0) depth--;
+                pos++;
+            }
+            toks.push_back(src.substr(start, pos - start));
+        }
+        return 0;
+    }
+
+    void skipBody() {
+        int depth = 1;
+        while (pos < src.size() && depth > 0) {
+            char c = src[pos];
+            if (c == '"' || c == '\'') { skipLiteral(); continue; }
+            if (at("//")) { skipLine(); continue; }
+            if (at("/*")) { skipBlock(); continue; }
+            if (c == '{') depth++;
+            else if (c == '}') depth--;
+            pos++;
+        }
+    }
+
+    string_view join(const vector<string_view>& toks, size_t from, size_t to) {
+        string s;
+        for (size_t i = from; i < to; i++) {
+            string_view t = toks[i];
+            bool glue = s.empty() || t == "*" || t == "&" || t == "&&" || t == "," || t == ">" || t == ")" ||
+                t == "]" || t == "[" || t == "::" || t == "(" || t == "}" || s.back() == '<' || s.back() == '(' || s.back() == '{' ||
+                s.back() == '[' || (s.size() >= 2 && s.compare(s.size() - 2, 2, "::") == 0) || t == "<";
+            if (!glue) s += ' ';
+            s += t;
+            if (t == ",") s += ' ';
+        }
+        return strings.intern(s);
+    }
+
+    static bool isIdent(string_view t) { return !t.empty() && identChar(t[0]) && !isdigit(static_cast<unsigned char>(t[0])); }
+
+    string_view text(const string& s) { return arena.copy(s); }
+
+    // Parses "type name [= value]" declarators (parameters or data members).
+    Field declarator(const vector<string_view>& toks, size_t from, size_t to, string_view inheritedType = {}) {
+        Field f;
+        size_t end = to;
+        for (size_t i = from; i < to; i++) {
+            if (toks[i] == "=" || (toks[i] == "{" && i > from)) {
+                end = i;
+                size_t vb = i + (toks[i] == "=" ? 1 : 0);
+                f.defval = join(toks, vb, to);
+                break;
+            }
+            if (toks[i] == ":" && inheritedType.empty() && i > from) { end = i; break; }
+        }
+        size_t nameAt = end;
+        for (size_t i = end; i-- > from;) {
+            if (toks[i] == "[" || toks[i] == "]" || (!isIdent(toks[i]) && i + 1 < end && toks[i + 1] == "]")) continue;
+            if (isIdent(toks[i]) && (i > from || !inheritedType.empty())) nameAt = i;
+            break;
+        }
+        if (nameAt == end) {
+            f.type = join(toks, from, end);
+            return f;
+        }
+        f.name = toks[nameAt];
+        string_view type = join(toks, from, nameAt);
+        string_view suffix = nameAt + 1 < end ? join(toks, nameAt + 1, end) : string_view();
+        if (!inheritedType.empty()) type = type.empty() ? inheritedType : strings.intern(string(inheritedType) + string(type));
+        f.type = suffix.empty() ? type : strings.intern(string(type) + string(suffix));
+        return f;
+    }
+
+    string_view describe(const Doc& d) {
+        string s = d.brief;
+        append(s, d.text);
+        return text(s);
+    }
+
+    void members(bool isEnum) {
+        vector<string_view> toks;
+        Doc pending;
+        size_t firstOfLast = fields.size();
+        for (;;) {
+            skipTrivia();
+            if (pos >= src.size()) return;
+            if (atTrailingDoc()) {
+                Doc d = parseDoc(readComment());
+                for (size_t i = firstOfLast; i < fields.size(); i++) fields[i].desc = describe(d);
+                continue;
+            }
+            if (atDocBlock() || atDocLine()) { pending = parseDoc(readComment()); continue; }
+            if (src[pos] == '}') { pos++; return; }
+            if (src[pos] == '#') { skipDirective(); continue; }
+
+            char term = declaration(toks, isEnum);
+            if (term == '}') pos++;
+            if (!isEnum && toks.size() >= 2 && toks[1] == ":" && (toks[0] == "public" || toks[0] == "private" || toks[0] == "protected")) {
+                toks.erase(toks.begin(), toks.begin() + 2);
+            }
+            bool method = find(toks.begin(), toks.end(), "(") != toks.end();
+            if (term == '{') {
+                skipBody();
+                if (!method) { vector<string_view> rest; declaration(rest); }
+            }
+            firstOfLast = fields.size();
+            if (!toks.empty() && !method && toks[0] != "using" && toks[0] != "typedef" && toks[0] != "friend" && toks[0] != "static_assert") {
+                if (isEnum) {
+                    Field f;
+                    f.name = toks[0];
+                    if (toks.size() > 2 && toks[1] == "=") f.defval = join(toks, 2, toks.size());
+                    fields.push_back(f);
+                } else {
+                    size_t start = 0;
+                    string_view type;
+                    for (size_t i = 0, depth = 0; i <= toks.size(); i++) {
+                        if (i < toks.size() && (toks[i] == "<" || toks[i] == "(" || toks[i] == "[")) depth++;
+                        if (i < toks.size() && (toks[i] == ">" || toks[i] == ")" || toks[i] == "]") && depth) depth--;
+                        if (i == toks.size() || (toks[i] == "," && depth == 0)) {
+                            Field f = declarator(toks, start, i, type);
+                            if (type.empty()) type = f.type;
+                            fields.push_back(f);
+                            start = i + 1;
                         }
-                        match(TOK_SEMI);
-                    } else {
-                        d.fields.push_back(field());
                     }
                 }
-                else eat();
+                if (pending.present) for (size_t i = firstOfLast; i < fields.size(); i++) fields[i].desc = describe(pending);
             }
-            expect(TOK_RB);
-            defs.push_back(d);
+            pending = Doc();
+            if (term == '}') return;
         }
-        
-        return defs;
     }
-};
 
-string escape(const string& s) {
-    string r;
-    for (char c : s) {
-        switch(c) {
-            case '<': r += "&lt;"; break;
-            case '>': r += "&gt;"; break;
-            case '&': r += "&amp;"; break;
-            case '"': r += "&quot;"; break;
-            case '\'': r += "&#39;"; break;
-            default: r += c;
+    void emit(Def& d, const Doc& doc) {
+        d.desc = describe(doc);
+        if (!doc.since.empty()) d.since = strings.intern(doc.since);
+        if (!doc.version.empty()) d.version = strings.intern(doc.version);
+        if (!doc.author.empty()) d.author = strings.intern(doc.author);
+        if (!doc.category.empty()) d.category = strings.intern(doc.category);
+        if (!doc.deprecated.empty()) d.deprecated = text(doc.deprecated);
+        for (const auto& n : doc.notes) notes.push_back(text(n));
+        for (const auto& l : doc.links) links.push_back(strings.intern(l));
+        for (const auto& t : doc.tags) tags.push_back(strings.intern(t));
+        for (const auto& m : doc.meta) meta.emplace_back(strings.intern(m.first), text(m.second));
+        if (!doc.returns.empty()) {
+            if (d.ret.empty()) d.ret = text(doc.returns);
+            else meta.emplace_back("returns", text(doc.returns));
+        }
+        for (const auto& p : doc.params) {
+            auto f = find_if(fields.begin(), fields.end(), [&](const Field& x) { return x.name == p.first; });
+            if (f == fields.end()) { fields.emplace_back(); f = fields.end() - 1; f->name = text(p.first); }
+            f->desc = text(p.second);
         }
+        stable_sort(meta.begin(), meta.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        d.fields = arena.list(fields);
+        d.links = arena.list(links);
+        d.notes = arena.list(notes);
+        d.tags = arena.list(tags);
+        d.meta = arena.list(meta);
+        defs.push_back(d);
     }
-    return r;
-}
 
-string linkify(const string& type, const map<string, string>& nameMap) {
-    string result, current;
-    
-    for (char c : type) {
-        if (isalnum(c) || c == '_') {
-            current += c;
-        } else {
-            if (!current.empty()) {
-                result += nameMap.count(current) ? 
-                    "<a href=\"" + nameMap.at(current) + "\" class=\"type-link\">" + escape(current) + "</a>" :
-                    escape(current);
-                current.clear();
+    void documented(const Doc& doc) {
+        fields.clear(); links.clear(); notes.clear(); tags.clear(); meta.clear();
+        Def d;
+        skipTrivia();
+        if (pos >= src.size() || atDocBlock() || atDocLine()) return;
+
+        if (at("#define")) {
+            pos += 7;
+            while (peek() == ' ' || peek() == '\t') pos++;
+            size_t start = pos;
+            while (pos < src.size() && identChar(src[pos])) pos++;
+            d.kind = strings.intern("const");
+            d.name = src.substr(start, pos - start);
+            size_t vstart = pos;
+            skipDirective();
+            string value = trim(src.substr(vstart, pos - vstart));
+            if (!value.empty()) meta.emplace_back("value", text(value));
+            if (!d.name.empty()) emit(d, doc);
+            return;
+        }
+        if (src[pos] == '#') { skipDirective(); return; }
+
+        vector<string_view> toks;
+        char term = declaration(toks);
+        size_t i = 0;
+        if (i < toks.size() && toks[i] == "template") {
+            int depth = 0;
+            for (i++; i < toks.size(); i++) {
+                if (toks[i] == "<") depth++;
+                else if (toks[i] == ">" && --depth == 0) { i++; break; }
+            }
+        }
+        bool typedefd = i < toks.size() && toks[i] == "typedef";
+        if (typedefd) i++;
+        if (i < toks.size() && toks[i] == "extern" && i + 1 < toks.size() && toks[i + 1][0] == '"') i += 2;
+        if (i >= toks.size() || toks[i] == "namespace") return;
+
+        string_view first = toks[i];
+        if (first == "struct" || first == "class" || first == "union" || first == "enum") {
+            bool isEnum = first == "enum";
+            size_t n = i + 1;
+            if (isEnum && n < toks.size() && (toks[n] == "class" || toks[n] == "struct")) n++;
+            while (n < toks.size() && (toks[n] == "alignas" || toks[n] == "__attribute__" || toks[n] == "__declspec" || toks[n] == "[")) {
+                int depth = 0;
+                for (n++; n < toks.size(); n++) {
+                    if (toks[n] == "(" || toks[n] == "[") depth++;
+                    else if ((toks[n] == ")" || toks[n] == "]") && --depth <= 0) { n++; break; }
+                }
+            }
+            bool hasBody = term == '{';
+            if (!hasBody && (find(toks.begin(), toks.end(), "(") != toks.end() || (!typedefd && toks.size() > n + 1 && toks[n + 1] != ":"))) {
+                if (typedefd) { d.kind = strings.intern("type"); d.name = toks.back(); emit(d, doc); }
+                return;
+            }
+            d.kind = strings.intern(first);
+            if (n < toks.size() && isIdent(toks[n])) d.name = toks[n];
+            if (isEnum && n + 2 < toks.size() && toks[n + 1] == ":") meta.emplace_back("underlying", join(toks, n + 2, toks.size()));
+            if (hasBody) {
+                members(isEnum);
+                vector<string_view> rest;
+                declaration(rest);
+                if (typedefd && !rest.empty() && isIdent(rest.back())) d.name = rest.back();
+            }
+            if (!d.name.empty()) emit(d, doc);
+            return;
+        }
+
+        if (first == "using") {
+            if (term == '{') skipBody();
+            if (i + 2 < toks.size() && toks[i + 2] == "=") {
+                d.kind = strings.intern("type");
+                d.name = toks[i + 1];
+                meta.emplace_back("alias", join(toks, i + 3, toks.size()));
+                emit(d, doc);
+            }
+            return;
+        }
+
+        static const string_view specifiers[] = { "static", "inline", "extern", "virtual", "explicit", "friend", "constexpr", "consteval", "[[nodiscard]]" };
+        auto paren = find(toks.begin() + i, toks.end(), "(");
+        if (paren != toks.end() && !typedefd) {
+            if (term == '{') skipBody();
+            size_t p = paren - toks.begin();
+            if (p == i || !isIdent(toks[p - 1])) return;
+            d.kind = strings.intern("fn");
+            d.name = toks[p - 1];
+            vector<string_view> ret;
+            for (size_t k = i; k + 1 < p; k++) {
+                if (find(begin(specifiers), end(specifiers), toks[k]) == end(specifiers)) ret.push_back(toks[k]);
+            }
+            if (!ret.empty()) d.ret = join(ret, 0, ret.size());
+            size_t close = p + 1;
+            for (int depth = 1; close < toks.size(); close++) {
+                if (toks[close] == "(") depth++;
+                else if (toks[close] == ")" && --depth == 0) break;
+            }
+            if (!(close == p + 2 && toks[p + 1] == "void")) {
+                size_t start = p + 1;
+                for (size_t k = p + 1, depth = 0; k <= close && k < toks.size(); k++) {
+                    if (toks[k] == "(" || toks[k] == "<" || toks[k] == "[" || toks[k] == "{") depth++;
+                    if ((toks[k] == ")" || toks[k] == ">" || toks[k] == "]" || toks[k] == "}") && depth && k != close) depth--;
+                    if (k == close || (toks[k] == "," && depth == 0)) {
+                        if (k > start) fields.push_back(declarator(toks, start, k));
+                        start = k + 1;
+                    }
+                }
+            }
+            emit(d, doc);
+            return;
+        }
+
+        if (term == '{') { skipBody(); return; }
+        if (typedefd) {
+            d.kind = strings.intern("type");
+            size_t nameAt = toks.size();
+            while (nameAt > i && !isIdent(toks[nameAt - 1])) nameAt--;
+            bool fnPtr = false;
+            for (size_t k = i; k + 2 < toks.size() && !fnPtr; k++) {
+                fnPtr = toks[k] == "(" && (toks[k + 1] == "*" || toks[k + 1] == "&") && isIdent(toks[k + 2]);
+                if (fnPtr) nameAt = k + 3;
             }
-            result += escape(string(1, c));
+            if (nameAt == i) return;
+            d.name = toks[nameAt - 1];
+            meta.emplace_back("alias", join(toks, i, fnPtr ? toks.size() : nameAt - 1));
+            emit(d, doc);
+            return;
+        }
+        if (find(toks.begin(), toks.end(), "const") != toks.end() || find(toks.begin(), toks.end(), "constexpr") != toks.end()) {
+            vector<string_view> decl;
+            for (size_t k = i; k < toks.size(); k++) {
+                if (find(begin(specifiers), end(specifiers), toks[k]) == end(specifiers) || toks[k] == "constexpr") decl.push_back(toks[k]);
+            }
+            Field f = declarator(decl, 0, decl.size());
+            if (f.name.empty()) return;
+            d.kind = strings.intern("const");
+            d.name = f.name;
+            meta.emplace_back("type", f.type);
+            if (!f.defval.empty()) meta.emplace_back("value", f.defval);
+            emit(d, doc);
         }
     }
-    
-    if (!current.empty()) {
-        result += nameMap.count(current) ? 
-            "<a href=\"" + nameMap.at(current) + "\" class=\"type-link\">" + escape(current) + "</a>" :
-            escape(current);
+
+public:
+    HeaderScanner(string_view s, Arena& a) : src(s), arena(a), strings(a) {}
+
+    vector<Def> scan() {
+        while (pos < src.size()) {
+            char c = src[pos];
+            if (c == '/' && (atDocBlock() || atDocLine()) && !atTrailingDoc()) documented(parseDoc(readComment()));
+            else if (at("//")) skipLine();
+            else if (at("/*")) skipBlock();
+            else if (c == '"' || c == '\'') skipLiteral();
+            else if (c == '#') skipDirective();
+            else pos++;
+        }
+        return move(defs);
     }
-    
-    return result;
+};
+
+bool isHeader(const filesystem::path& p) {
+    string ext = p.extension().string();
+    return ext == ".h" || ext == ".hh" || ext == ".hpp" || ext == ".hxx" || ext == ".h++";
 }
 
-string getStyle() {
-    return R"(
-* { margin: 0; padding: 0; box-sizing: border-box; }
-body { font-family: -apple-system, BlinkMacSystemFont, 'Segoe UI', Roboto, sans-serif; background: #0d1117; color: #c9d1d9; line-height: 1.6; }
-.container { max-width: 1400px; margin: 0 auto; padding: 20px; }
-.header { padding: 30px 0; border-bottom: 1px solid #30363d; margin-bottom: 30px; }
-.header h1 { font-size: 32px; font-weight: 600; color: #f0f6fc; margin-bottom: 8px; }
-.header .subtitle { color: #8b949e; font-size: 16px; }
-.header .stats { display: flex; gap: 20px; margin-top: 15px; font-size: 14px; color: #8b949e; }
-.stat-item { display: flex; align-items: center; gap: 6px; }
-.nav { display: flex; gap: 20px; margin: 20px 0; padding: 15px 0; border-bottom: 1px solid #30363d; flex-wrap: wrap; }
-.nav a { color: #58a6ff; text-decoration: none; font-size: 14px; padding: 8px 16px; border-radius: 6px; transition: all 0.2s; }
-.nav a:hover { background: #161b22; }
-.nav a.active { background: #0d419d; color: #fff; }
-.search-container { display: flex; gap: 10px; margin-bottom: 20px; flex-wrap: wrap; }
-.search-box { flex: 1; min-width: 300px; padding: 10px 16px; background: #0d1117; border: 1px solid #30363d; border-radius: 6px; color: #c9d1d9; font-size: 14px; }
-.search-box:focus { outline: none; border-color: #58a6ff; box-shadow: 0 0 0 3px rgba(88, 166, 255, 0.1); }
-.view-toggle { display: flex; gap: 5px; }
-.view-btn { padding: 8px 12px; background: #21262d; border: 1px solid #30363d; border-radius: 6px; color: #8b949e; cursor: pointer; transition: all 0.2s; }
+inline bool needsEscape(char c) { return c == '<' || c == '>' || c == '&' || c == '"' || c == '\''; }
+
+// Escape kernels: return the offset of the first of <>&"' in p[0, n), or n.
+size_t findSpecialScalar(const char* p, size_t n) {
+    for (size_t i = 0; i < n; i++) if (needsEscape(p[i])) return i;
+    return n;
+}
+
+#if defined(__x86_64__)
+size_t findSpecialSSE2(const char* p, size_t n) {
+    const __m128i lt = _mm_set1_epi8('<'), gt = _mm_set1_epi8('>'), amp = _mm_set1_epi8('&');
+    const __m128i quot = _mm_set1_epi8('"'), apos = _mm_set1_epi8('\'');
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lt), _mm_cmpeq_epi8(v, gt)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, amp), _mm_or_si128(_mm_cmpeq_epi8(v, quot), _mm_cmpeq_epi8(v, apos))));
+        if (int bits = _mm_movemask_epi8(m)) return i + __builtin_ctz(bits);
+    }
+    return i + findSpecialScalar(p + i, n - i);
+}
+
+__attribute__((target("avx2"))) size_t findSpecialAVX2(const char* p, size_t n) {
+    const __m256i lt = _mm256_set1_epi8('<'), gt = _mm256_set1_epi8('>'), amp = _mm256_set1_epi8('&');
+    const __m256i quot = _mm256_set1_epi8('"'), apos = _mm256_set1_epi8('\'');
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, lt), _mm256_cmpeq_epi8(v, gt)),
+                                    _mm256_or_si256(_mm256_cmpeq_epi8(v, amp), _mm256_or_si256(_mm256_cmpeq_epi8(v, quot), _mm256_cmpeq_epi8(v, apos))));
+        if (unsigned bits = _mm256_movemask_epi8(m)) return i + __builtin_ctz(bits);
+    }
+    return i + findSpecialScalar(p + i, n - i);
+}
+#endif
+
+using FindSpecial = size_t (*)(const char*, size_t);
+
+FindSpecial pickFindSpecial() {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2")) return findSpecialAVX2;
+    return findSpecialSSE2;
+#else
+    return findSpecialScalar;
+#endif
+}
+
+const FindSpecial findSpecial = pickFindSpecial();
+
+void appendEscaped(string& r, string_view s, FindSpecial find = findSpecial) {
+    const char* p = s.data();
+    size_t n = s.size();
+    while (n > 0) {
+        size_t i = find(p, n);
+        r.append(p, i);
+        if (i == n) break;
+        switch (p[i]) {
+            case '<': r.append("&lt;", 4); break;
+            case '>': r.append("&gt;", 4); break;
+            case '&': r.append("&amp;", 5); break;
+            case '"': r.append("&quot;", 6); break;
+            default: r.append("&#39;", 5);
+        }
+        p += i + 1;
+        n -= i + 1;
+    }
+}
+
+string escape(string_view s) {
+    string r;
+    appendEscaped(r, s);
+    return r;
+}
+
+struct Escaped { string_view s; };
+
+Escaped esc(string_view s) { return { s }; }
+
+struct Linked { Span<TypeToken> refs; };
+
+Linked linkify(Span<TypeToken> refs) { return { refs }; }
+
+size_t utf8Length(const unsigned char* p, size_t n) {
+    unsigned char c = p[0], lo = 0x80, hi = 0xBF;
+    size_t len;
+    if (c >= 0xC2 && c <= 0xDF) len = 2;
+    else if (c >= 0xE0 && c <= 0xEF) { len = 3; if (c == 0xE0) lo = 0xA0; if (c == 0xED) hi = 0x9F; }
+    else if (c >= 0xF0 && c <= 0xF4) { len = 4; if (c == 0xF0) lo = 0x90; if (c == 0xF4) hi = 0x8F; }
+    else return 0;
+    if (n < len || p[1] < lo || p[1] > hi) return 0;
+    for (size_t i = 2; i < len; i++) {
+        if ((p[i] & 0xC0) != 0x80) return 0;
+    }
+    return len;
+}
+
+// Invalid UTF-8 becomes U+FFFD.
+void appendJson(string& r, string_view s) {
+    static const char hex[] = "0123456789abcdef";
+    const char* p = s.data();
+    size_t n = s.size(), run = 0;
+    r += '"';
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = p[i];
+        if (c >= 0x80) {
+            if (size_t len = utf8Length(reinterpret_cast<const unsigned char*>(p + i), n - i)) { i += len - 1; continue; }
+            r.append(p + run, i - run);
+            r.append("\xEF\xBF\xBD", 3);
+            run = i + 1;
+            continue;
+        }
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        r.append(p + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"': r.append("\\\"", 2); break;
+            case '\\': r.append("\\\\", 2); break;
+            case '\n': r.append("\\n", 2); break;
+            case '\t': r.append("\\t", 2); break;
+            case '\r': r.append("\\r", 2); break;
+            default: {
+                char u[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+                r.append(u, 6);
+            }
+        }
+    }
+    r.append(p + run, n - run);
+    r += '"';
+}
+
+struct JsonStr { string_view s; };
+
+JsonStr json(string_view s) { return { s }; }
+
+uint64_t fnv1a(string_view s, uint64_t h = 14695981039346656037ULL) {
+    for (unsigned char c : s) { h ^= c; h *= 1099511628211ULL; }
+    return h;
+}
+
+class Archive;
+
+// Set once in main; archive is set while an Archive is being written.
+struct Output {
+    static inline bool minify = false, gzip = false, pageDirs = false;
+    static inline Archive* archive = nullptr;
+};
+
+// --layout=sharded: "3f/Name.html".
+unsigned pageDir(string_view name) { return (fnv1a(name) * 0x9e3779b97f4a7c15ULL) >> 56; }
+
+void appendPagePath(string& r, string_view name, bool dirs = Output::pageDirs) {
+    if (dirs) {
+        char d[4];
+        snprintf(d, sizeof d, "%02x/", pageDir(name));
+        r.append(d, 3);
+    }
+    r.append(name.data(), name.size());
+    r.append(".html", 5);
+}
+
+string pagePath(string_view name, bool dirs = Output::pageDirs) {
+    string r;
+    appendPagePath(r, name, dirs);
+    return r;
+}
+
+struct PageRef { string_view name; };
+
+PageRef page(string_view name) { return { name }; }
+
+// Elements whose surrounding whitespace is never rendered.
+bool isBlockTag(string_view t) {
+    switch (t.size()) {
+    case 1: return t == "p";
+    case 2: return t == "li" || t == "ul" || t == "ol" || t == "tr" || t == "td" || t == "th" || t == "br" ||
+                   (t[0] == 'h' && t[1] >= '1' && t[1] <= '6');
+    case 3: return t == "div" || t == "pre";
+    case 4: return t == "html" || t == "head" || t == "body" || t == "meta" || t == "link";
+    case 5: return t == "title" || t == "style" || t == "table" || t == "thead" || t == "tbody";
+    case 6: return t == "script";
+    case 7: return t == "DOCTYPE";
+    }
+    return false;
+}
+
+// Name of the tag starting at s[at] == '<', without a leading '/' or '!'.
+string_view tagName(string_view s, size_t at) {
+    size_t start = at + 1 + (at + 1 < s.size() && (s[at + 1] == '/' || s[at + 1] == '!'));
+    size_t end = start;
+    while (end < s.size() && (chars.cls[static_cast<unsigned char>(s[end])] & CC_IDENT) && s[end] != '<' && s[end] != '>') end++;
+    return s.substr(start, end - start);
+}
+
+// Compacts s[r, end) to s[w...) and returns the new w.
+size_t minifyCss(string& s, size_t r, size_t end, size_t w) {
+    auto tight = [](char c) { return c == '{' || c == '}' || c == ';' || c == ','; };
+    while (r < end) {
+        char c = s[r];
+        if (c == '/' && r + 1 < end && s[r + 1] == '*') {
+            size_t close = s.find("*/", r + 2);
+            r = close == string::npos || close + 2 > end ? end : close + 2;
+        } else if (c == '"' || c == '\'') {
+            size_t close = s.find(c, r + 1);
+            close = close == string::npos || close >= end ? end : close + 1;
+            while (r < close) s[w++] = s[r++];
+        } else if (chars.cls[static_cast<unsigned char>(c)] & CC_SPACE) {
+            while (r < end && (chars.cls[static_cast<unsigned char>(s[r])] & CC_SPACE)) r++;
+            bool after = w == 0 || tight(s[w - 1]) || s[w - 1] == ':' || s[w - 1] == '>';
+            if (!after && r < end && !tight(s[r]) && !(s[r] == '/' && r + 1 < end && s[r + 1] == '*')) s[w++] = ' ';
+        } else {
+            if (c == '}' && w && s[w - 1] == ';') w--;
+            s[w++] = s[r++];
+        }
+    }
+    return w;
+}
+
+// Next whitespace, control byte or '<'.
+size_t findMinifyStop(const char* p, size_t n) {
+    size_t i = 0;
+#if defined(__x86_64__)
+    const __m128i top = _mm_set1_epi8(' '), lt = _mm_set1_epi8('<');
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, top), v), _mm_cmpeq_epi8(v, lt));
+        if (int bits = _mm_movemask_epi8(m)) return i + __builtin_ctz(bits);
+    }
+#endif
+    for (; i < n; i++) {
+        if (static_cast<unsigned char>(p[i]) <= ' ' || p[i] == '<') return i;
+    }
+    return n;
+}
+
+// Tags, quoted attribute values and <pre> are copied verbatim.
+void minifyHtml(string& out) {
+    Phase phase("minify");
+    char* s = out.data();
+    size_t r = 0, w = 0, n = out.size();
+    auto copyTo = [&](size_t end) { if (w != r) memmove(s + w, s + r, end - r); w += end - r; r = end; };
+    auto space = [&](size_t i) { return chars.cls[static_cast<unsigned char>(s[i])] & CC_SPACE; };
+    auto find = [&](size_t from, string_view what) { return string_view(s, n).find(what, from); };
+    while (r < n) {
+        copyTo(r + findMinifyStop(s + r, n - r));
+        if (r == n) break;
+        if (!space(r) && s[r] != '<') { copyTo(r + 1); continue; }
+        
+        if (s[r] == '<') {
+            string_view name = tagName(string_view(s, n), r);
+            const char* close = name == "pre" ? "</pre" : name == "style" ? "</style" : name == "script" ? "</script" : nullptr;
+            if (r + 1 < n && s[r + 1] == '/') close = nullptr;
+            size_t gt = r + 1;
+            while (gt < n && s[gt] != '>') {
+                if (s[gt] != '"' && s[gt] != '\'') { gt++; continue; }
+                const void* q = memchr(s + gt + 1, s[gt], n - gt - 1);
+                gt = q ? static_cast<const char*>(q) - s + 1 : n;
+            }
+            copyTo(gt < n ? gt + 1 : n);
+            if (!close) continue;
+            size_t end = find(r, close);
+            if (end == string::npos) end = n;
+            if (close[2] == 'p') copyTo(end);
+            else if (close[3] == 't') { w = minifyCss(out, r, end, w); r = end; }
+            else {
+                while (r < end) {
+                    while (r < end && space(r)) r++;
+                    size_t nl = find(r, "\n");
+                    copyTo(nl == string::npos || nl >= end ? end : nl + 1);
+                }
+            }
+            continue;
+        }
+        
+        size_t end = r;
+        while (end < n && space(end)) end++;
+        bool drop = w == 0 || end == n;
+        if (!drop && s[w - 1] == '>') {
+            size_t lt = string_view(s, w).rfind('<');
+            drop = lt != string::npos && isBlockTag(tagName(string_view(s, w), lt));
+        }
+        if (!drop && s[end] == '<') drop = isBlockTag(tagName(string_view(s, n), end));
+        if (!drop) s[w++] = ' ';
+        r = end;
+    }
+    out.resize(w);
+}
+
+// A stream may be fed in pieces; last also resets it for the next one.
+class Gzip {
+    z_stream z = {};
+    
+public:
+    Gzip() {
+        if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY) != Z_OK) throw runtime_error("Cannot initialise zlib");
+    }
+    ~Gzip() { deflateEnd(&z); }
+    Gzip(const Gzip&) = delete;
+    Gzip& operator=(const Gzip&) = delete;
+    
+    void add(string_view s, string& out, bool last) {
+        Phase phase("compress");
+        const char* p = s.data();
+        size_t n = s.size();
+        for (;;) {
+            uInt step = static_cast<uInt>(min<size_t>(n, 1 << 30));
+            z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(p));
+            z.avail_in = step;
+            p += step;
+            n -= step;
+            int mode = last && n == 0 ? Z_FINISH : Z_NO_FLUSH;
+            do {
+                size_t at = out.size(), room = max<size_t>(deflateBound(&z, z.avail_in), 1 << 12);
+                out.resize(at + room);
+                z.next_out = reinterpret_cast<Bytef*>(&out[at]);
+                z.avail_out = static_cast<uInt>(room);
+                deflate(&z, mode);
+                out.resize(at + room - z.avail_out);
+            } while (z.avail_out == 0);
+            if (n == 0) break;
+        }
+        if (last) deflateReset(&z);
+    }
+};
+
+bool writeAll(int fd, const char* p, size_t size) {
+    for (size_t at = 0; at < size; ) {
+        ssize_t n = ::write(fd, p + at, size - at);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        at += n;
+    }
+    return true;
+}
+
+void replaceFile(const string& tmp, const string& path) {
+    if (rename(tmp.c_str(), path.c_str()) != 0) throw runtime_error("Cannot write output file '" + path + "'");
+}
+
+// --archive: ustar plus site.tar.idx (name, offset, size per file), renamed into place by finish().
+class Archive {
+    static constexpr size_t chunk = 4 << 20;
+    
+    mutex m;
+    string root, path, buf, index;
+    int fd = -1;
+    uint64_t offset = 0;
+    unsigned long long mtime = time(nullptr);
+    
+    void flush() {
+        Phase phase("write");
+        if (!writeAll(fd, buf.data(), buf.size())) throw runtime_error("Cannot write output file '" + path + "'");
+        if (Stats::on) Stats::lane().bytesOut += buf.size();
+        buf.clear();
+    }
+    
+    // Names over 100 bytes get a pax header first.
+    void header(string_view name, size_t size, char type) {
+        if (name.size() > 100) {
+            string rec = " path=" + string(name) + "\n";
+            size_t len = rec.size() + 1;
+            while (to_string(len).size() + rec.size() != len) len++;
+            rec = to_string(len) + rec;
+            header("PaxHeader", rec.size(), 'x');
+            append(rec);
+        }
+        char h[512] = {};
+        memcpy(h, name.data(), min<size_t>(name.size(), 100));
+        snprintf(h + 100, 8, "%07o", 0644);
+        snprintf(h + 108, 8, "%07o", 0);
+        snprintf(h + 116, 8, "%07o", 0);
+        snprintf(h + 124, 12, "%011llo", (unsigned long long)size);
+        snprintf(h + 136, 12, "%011llo", mtime);
+        memset(h + 148, ' ', 8);
+        h[156] = type;
+        memcpy(h + 257, "ustar\0" "00", 8);
+        unsigned sum = 0;
+        for (unsigned char c : h) sum += c;
+        snprintf(h + 148, 8, "%06o", sum);
+        buf.append(h, sizeof h);
+        offset += sizeof h;
+    }
+    
+    void append(string_view data) {
+        if (data.size() >= chunk) {
+            flush();
+            Phase phase("write");
+            if (!writeAll(fd, data.data(), data.size())) throw runtime_error("Cannot write output file '" + path + "'");
+            if (Stats::on) Stats::lane().bytesOut += data.size();
+        } else {
+            buf.append(data.data(), data.size());
+        }
+        buf.append(-data.size() & 511, '\0');
+        offset += (data.size() + 511) & ~size_t(511);
+        if (buf.size() >= chunk) flush();
+    }
+    
+public:
+    static constexpr const char* file = "/site.tar";
+    
+    explicit Archive(const string& outdir) : root(outdir + "/"), path(outdir + file) {
+        fd = open((path + ".tmp").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw runtime_error("Cannot write output file '" + path + "'");
+        index = "sdoc-archive 1\n";
+        Output::archive = this;
+    }
+    
+    ~Archive() {
+        Output::archive = nullptr;
+        if (fd >= 0) {
+            close(fd);
+            remove((path + ".tmp").c_str());
+        }
+    }
+    
+    Archive(const Archive&) = delete;
+    Archive& operator=(const Archive&) = delete;
+    
+    void add(const string& file, string_view data) {
+        string_view name = string_view(file).substr(file.compare(0, root.size(), root) == 0 ? root.size() : 0);
+        lock_guard<mutex> l(m);
+        header(name, data.size(), '0');
+        char t[48];
+        index.append(name.data(), name.size());
+        index.append(t, snprintf(t, sizeof t, "\t%llu\t%zu\n", (unsigned long long)offset, data.size()));
+        append(data);
+        if (Stats::on) Stats::lane().filesOut++;
+    }
+    
+    void finish() {
+        buf.append(1024, '\0');
+        flush();
+        if (close(fd) != 0) { fd = -1; throw runtime_error("Cannot write output file '" + path + "'"); }
+        fd = -1;
+        string idx = path + ".idx";
+        int f = open((idx + ".tmp").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool ok = f >= 0 && writeAll(f, index.data(), index.size());
+        if (f >= 0) close(f);
+        if (!ok) throw runtime_error("Cannot write output file '" + idx + "'");
+        replaceFile(path + ".tmp", path);
+        replaceFile(idx + ".tmp", idx);
+    }
+};
+
+class Out {
+    string b;
+    
+public:
+    Out& operator<<(string_view s) { b.append(s.data(), s.size()); return *this; }
+    Out& operator<<(char c) { b += c; return *this; }
+    Out& operator<<(Escaped e) { appendEscaped(b, e.s); return *this; }
+    Out& operator<<(JsonStr j) { appendJson(b, j.s); return *this; }
+    template <class T, class = enable_if_t<is_integral_v<T>>>
+    Out& operator<<(T n) {
+        char t[24];
+        b.append(t, to_chars(t, t + sizeof t, n).ptr);
+        return *this;
+    }
+    
+    Out& operator<<(Linked l) {
+        for (const auto& t : l.refs) {
+            if (t.sym < 0) appendEscaped(b, t.text);
+            else *this << "<a href=\"" << page(t.text) << "\" class=\"type-link\">" << esc(t.text) << "</a>";
+        }
+        return *this;
+    }
+    
+    Out& operator<<(PageRef p) { appendPagePath(b, p.name); return *this; }
+    
+    Out& write(const char* p, size_t n) { b.append(p, n); return *this; }
+    void clear() { b.clear(); }
+    size_t size() const { return b.size(); }
+    const string& str() const { return b; }
+    
+    static void save(const string& path, string_view data) {
+        Phase phase("write");
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw runtime_error("Cannot write output file '" + path + "'");
+        bool ok = writeAll(fd, data.data(), data.size());
+        close(fd);
+        if (!ok) throw runtime_error("Cannot write output file '" + path + "'");
+        if (Stats::on) {
+            Lane& lane = Stats::lane();
+            lane.filesOut++;
+            lane.bytesOut += data.size();
+        }
+    }
+    
+    void save(const string& path) const { save(path, b); }
+    
+    void minify() { minifyHtml(b); }
+    
+    void compact(string_view path) {
+        if (!Output::minify) return;
+        string_view ext = path.substr(path.rfind('.') + 1);
+        if (ext == "html") minifyHtml(b);
+        else if (ext == "css") b.resize(minifyCss(b, 0, b.size(), 0));
+    }
+    
+    void publish(const string& path) {
+        compact(path);
+        store(path, b);
+        if (Output::gzip) compress(path, b);
+    }
+    
+    static void store(const string& path, string_view data) {
+        if (Output::archive) Output::archive->add(path, data);
+        else save(path, data);
+    }
+    
+    static void compress(const string& path, string_view data) {
+        thread_local Gzip gzip;
+        thread_local string z;
+        z.clear();
+        gzip.add(data, z, true);
+        store(path + ".gz", z);
+    }
+    
+    void flush(int fd, const string& path) {
+        Phase phase("write");
+        if (!writeAll(fd, b.data(), b.size())) throw runtime_error("Cannot write output file '" + path + "'");
+        if (Stats::on) Stats::lane().bytesOut += b.size();
+        b.clear();
+    }
+};
+
+Out& threadBuffer() {
+    thread_local Out out;
+    out.clear();
+    return out;
+}
+
+string jsString(const string& s) {
+    string r = "\"";
+    for (size_t i = 0; i < s.size(); i++) {
+        char c = s[i];
+        switch (c) {
+            case '"': r += "\\\""; break;
+            case '\\': r += "\\\\"; break;
+            case '\n': r += "\\n"; break;
+            case '/': r += (i && s[i - 1] == '<') ? "\\/" : "/"; break;
+            default: r += c;
+        }
+    }
+    return r + "\"";
+}
+
+void Stats::report(ostream& out) {
+    struct Total { int64_t first = 0, ns = 0; size_t calls = 0; };
+    map<string_view, Total> phases;
+    vector<int64_t> renders;
+    Lane sum;
+    size_t threads;
+    {
+        lock_guard<mutex> l(m);
+        threads = lanes.size();
+        for (const auto& lane : lanes) {
+            for (const auto& e : lane->events) {
+                auto it = phases.find(e.name);
+                if (it == phases.end()) it = phases.emplace(e.name, Total{ e.start, 0, 0 }).first;
+                it->second.first = min(it->second.first, e.start);
+                it->second.ns += e.dur;
+                it->second.calls++;
+                if (strcmp(e.name, "render") == 0) renders.push_back(e.dur);
+            }
+            sum.addCounters(*lane);
+        }
+    }
+    vector<pair<string_view, Total>> order(phases.begin(), phases.end());
+    sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.second.first < b.second.first; });
+    
+    char line[160];
+    snprintf(line, sizeof line, "Build statistics (%zu threads, %.1f ms wall)\n", threads, now() / 1e6);
+    out << line;
+    snprintf(line, sizeof line, "  %-14s %9s %12s %12s\n", "phase", "calls", "busy ms", "mean us");
+    out << line;
+    for (const auto& p : order) {
+        snprintf(line, sizeof line, "  %-14.*s %9zu %12.1f %12.1f\n", (int)p.first.size(), p.first.data(), p.second.calls,
+                 p.second.ns / 1e6, p.second.ns / 1e3 / p.second.calls);
+        out << line;
+    }
+    if (!renders.empty()) {
+        sort(renders.begin(), renders.end());
+        auto pct = [&](size_t p) { return renders[min(renders.size() - 1, renders.size() * p / 100)] / 1e3; };
+        snprintf(line, sizeof line, "  render per page: p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n",
+                 pct(50), pct(90), pct(99), renders.back() / 1e3);
+        out << line;
+    }
+    snprintf(line, sizeof line, "  read:    %llu files, %.2f MB, %llu tokens\n", (unsigned long long)sum.filesIn, sum.bytesIn / 1e6,
+             (unsigned long long)sum.tokens);
+    out << line;
+    snprintf(line, sizeof line, "  written: %llu files, %.2f MB\n", (unsigned long long)sum.filesOut, sum.bytesOut / 1e6);
+    out << line;
+    snprintf(line, sizeof line, "  arena:   %llu allocations, %.2f MB\n", (unsigned long long)sum.allocs, sum.allocBytes / 1e6);
+    out << line;
+}
+
+// Chrome trace-event JSON, one lane per thread.
+void Stats::saveTrace(const string& path) {
+    Out f;
+    char num[64];
+    auto us = [&](int64_t ns) { snprintf(num, sizeof num, "%.3f", ns / 1e3); return string_view(num); };
+    Lane sum;
+    f << "{\"traceEvents\": [\n";
+    {
+        lock_guard<mutex> l(m);
+        for (const auto& lane : lanes) {
+            f << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << lane->id
+              << ", \"args\": {\"name\": \"thread " << lane->id << "\"}},\n";
+            for (const auto& e : lane->events) {
+                f << "{\"name\": " << jsString(e.name) << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << lane->id << ", \"ts\": " << us(e.start);
+                f << ", \"dur\": " << us(e.dur) << "},\n";
+            }
+            sum.addCounters(*lane);
+        }
+    }
+    f << "{\"name\": \"counters\", \"ph\": \"C\", \"pid\": 1, \"tid\": 0, \"ts\": " << us(now()) << ", \"args\": {";
+    f << "\"files_in\": " << sum.filesIn << ", \"bytes_in\": " << sum.bytesIn << ", \"tokens\": " << sum.tokens;
+    f << ", \"files_out\": " << sum.filesOut << ", \"bytes_out\": " << sum.bytesOut << ", \"arena_allocs\": " << sum.allocs << "}}\n";
+    f << "], \"displayTimeUnit\": \"ms\"}\n";
+    f.save(path);
+}
+
+string_view getStyle() {
+    return R"(
+* { margin: 0; padding: 0; box-sizing: border-box; }
+body { font-family: -apple-system, BlinkMacSystemFont, 'Segoe UI', Roboto, sans-serif; background: #0d1117; color: #c9d1d9; line-height: 1.6; }
+.container { max-width: 1400px; margin: 0 auto; padding: 20px; }
+.header { padding: 30px 0; border-bottom: 1px solid #30363d; margin-bottom: 30px; }
+.header h1 { font-size: 32px; font-weight: 600; color: #f0f6fc; margin-bottom: 8px; }
+.header .subtitle { color: #8b949e; font-size: 16px; }
+.header .stats { display: flex; gap: 20px; margin-top: 15px; font-size: 14px; color: #8b949e; }
+.stat-item { display: flex; align-items: center; gap: 6px; }
+.nav { display: flex; gap: 20px; margin: 20px 0; padding: 15px 0; border-bottom: 1px solid #30363d; flex-wrap: wrap; }
+.nav a { color: #58a6ff; text-decoration: none; font-size: 14px; padding: 8px 16px; border-radius: 6px; transition: all 0.2s; }
+.nav a:hover { background: #161b22; }
+.nav a.active { background: #0d419d; color: #fff; }
+.search-container { display: flex; gap: 10px; margin-bottom: 20px; flex-wrap: wrap; }
+.search-box { flex: 1; min-width: 300px; padding: 10px 16px; background: #0d1117; border: 1px solid #30363d; border-radius: 6px; color: #c9d1d9; font-size: 14px; }
+.search-box:focus { outline: none; border-color: #58a6ff; box-shadow: 0 0 0 3px rgba(88, 166, 255, 0.1); }
+.view-toggle { display: flex; gap: 5px; }
+.view-btn { padding: 8px 12px; background: #21262d; border: 1px solid #30363d; border-radius: 6px; color: #8b949e; cursor: pointer; transition: all 0.2s; }
 .view-btn:hover { border-color: #58a6ff; color: #58a6ff; }
 .view-btn.active { background: #0d419d; color: #fff; border-color: #0d419d; }
 .filters { display: flex; gap: 10px; flex-wrap: wrap; margin-bottom: 20px; }
@@ -341,6 +1809,7 @@ body { font-family: -apple-system, BlinkMacSystemFont, 'Segoe UI', Roboto, sans-
 .filter-btn:hover { border-color: #58a6ff; color: #58a6ff; }
 .filter-btn.active { background: #0d419d; color: #fff; border-color: #0d419d; }
 .grid { display: grid; grid-template-columns: repeat(auto-fill, minmax(350px, 1fr)); gap: 20px; }
+.shard { display: contents; }
 .list-view { display: flex; flex-direction: column; gap: 15px; }
 .card { background: #161b22; border: 1px solid #30363d; border-radius: 6px; padding: 20px; transition: all 0.2s; }
 .card:hover { border-color: #58a6ff; transform: translateY(-2px); box-shadow: 0 4px 12px rgba(0, 0, 0, 0.3); }
@@ -384,6 +1853,7 @@ body { font-family: -apple-system, BlinkMacSystemFont, 'Segoe UI', Roboto, sans-
 .link-item { padding: 10px; background: #0d1117; border: 1px solid #30363d; border-radius: 4px; }
 .link-item a { color: #58a6ff; text-decoration: none; font-size: 14px; }
 .link-item a:hover { text-decoration: underline; }
+.used-as { display: block; margin-top: 4px; font-size: 12px; color: #8b949e; }
 .example-block { background: #0d1117; border: 1px solid #30363d; border-radius: 6px; padding: 15px; margin: 10px 0; }
 .example-block pre { color: #c9d1d9; overflow-x: auto; white-space: pre-wrap; word-wrap: break-word; }
 .note-block { background: #1c2128; border-left: 3px solid #58a6ff; padding: 12px 15px; margin: 10px 0; border-radius: 4px; }
@@ -398,6 +1868,7 @@ body { font-family: -apple-system, BlinkMacSystemFont, 'Segoe UI', Roboto, sans-
 .two-column { display: grid; grid-template-columns: 250px 1fr; gap: 30px; }
 .no-results { text-align: center; padding: 60px 20px; color: #8b949e; }
 .no-results h3 { font-size: 20px; margin-bottom: 10px; }
+.searching .card:not(.hit) { display: none; }
 @media (max-width: 900px) {
     .two-column { grid-template-columns: 1fr; }
     .sidebar { position: static; max-height: none; }
@@ -406,94 +1877,118 @@ body { font-family: -apple-system, BlinkMacSystemFont, 'Segoe UI', Roboto, sans-
 )";
 }
 
-void generateIndex(const vector<Def>& defs, const string& outdir) {
-    ofstream f(outdir + "/index.html");
-    
-    set<string> allTags, allCategories;
-    map<string, int> kindCount;
-    for (const auto& d : defs) {
-        for (const auto& t : d.tags) allTags.insert(t);
-        if (!d.category.empty()) allCategories.insert(d.category);
-        kindCount[d.kind]++;
+struct Style {
+    string css;
+    string href;
+};
+
+void styleTag(Out& f, const Style& style) {
+    if (style.href.empty()) f << "<style>\n" << style.css << "</style>\n";
+    else f << "<link rel=\"stylesheet\" href=\"" << style.href << "\">\n";
+}
+
+// Words plus their camelCase and snake_case parts, lower-cased.
+void searchTerms(string_view s, vector<string>& out) {
+    auto word = [](char c) { return isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+    for (size_t i = 0; i < s.size();) {
+        if (!word(s[i])) { i++; continue; }
+        size_t start = i;
+        while (i < s.size() && word(s[i])) i++;
+        string w(s.substr(start, i - start));
+        size_t part = 0;
+        for (size_t k = 1; k <= w.size(); k++) {
+            bool cut = k == w.size() || w[k] == '_' || (isupper(static_cast<unsigned char>(w[k])) && islower(static_cast<unsigned char>(w[k - 1])));
+            if (!cut) continue;
+            if (k > part && (part > 0 || k < w.size())) out.push_back(w.substr(part, k - part));
+            part = k < w.size() && w[k] == '_' ? k + 1 : k;
+        }
+        out.push_back(w);
     }
+}
+
+// search-index.js: sorted terms with delta-encoded posting lists of card positions.
+class SearchIndex {
+    unordered_map<string, vector<uint32_t>> postings;
+    map<string, int, less<>> kinds, categories;
+    vector<string> terms;
     
-    f << "<!DOCTYPE html>\n<html lang=\"en\">\n<head>\n<meta charset=\"UTF-8\">\n<meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">\n";
-    f << "<title>API Documentation</title>\n<style>\n" << getStyle() << "</style>\n</head>\n<body>\n";
-    f << "<div class=\"container\">\n";
-    f << "<div class=\"header\">\n<h1>API Documentation</h1>\n<div class=\"subtitle\">Complete reference for all types and functions</div>\n";
-    f << "<div class=\"stats\">\n";
-    f << "<span class=\"stat-item\">📦 " << defs.size() << " Total Items</span>\n";
-    for (const auto& kc : kindCount) {
-        f << "<span class=\"stat-item\">" << kc.second << " " << kc.first << "</span>\n";
+    static void count(map<string, int, less<>>& m, string_view key) {
+        auto it = m.find(key);
+        if (it == m.end()) it = m.emplace(string(key), 0).first;
+        it->second++;
     }
-    f << "</div>\n</div>\n";
-    
-    f << "<div class=\"search-container\">\n";
-    f << "<input type=\"text\" class=\"search-box\" id=\"search\" placeholder=\"Search by name, description, or tags...\" onkeyup=\"filterItems()\">\n";
-    f << "<div class=\"view-toggle\">\n";
-    f << "<button class=\"view-btn active\" onclick=\"setView('grid')\">Grid</button>\n";
-    f << "<button class=\"view-btn\" onclick=\"setView('list')\">List</button>\n";
-    f << "</div>\n</div>\n";
     
-    f << "<div class=\"filters\">\n";
-    f << "<button class=\"filter-btn active\" onclick=\"filterByType('all')\">All</button>\n";
-    for (const auto& kc : kindCount) {
-        f << "<button class=\"filter-btn\" onclick=\"filterByType('" << kc.first << "')\">" << kc.first << "</button>\n";
-    }
-    if (!allCategories.empty()) {
-        f << "<span style=\"color: #30363d; margin: 0 5px;\">|</span>\n";
-        for (const auto& cat : allCategories) {
-            f << "<button class=\"filter-btn\" onclick=\"filterByCategory('" << escape(cat) << "')\">" << escape(cat) << "</button>\n";
+public:
+    void add(uint32_t id, const Def& d) {
+        terms.clear();
+        searchTerms(d.name, terms);
+        searchTerms(d.desc, terms);
+        searchTerms(d.category, terms);
+        for (const auto& t : d.tags) searchTerms(t, terms);
+        for (const auto& f : d.fields) searchTerms(f.name, terms);
+        for (auto& t : terms) {
+            transform(t.begin(), t.end(), t.begin(), [](unsigned char c) { return tolower(c); });
+            auto& ids = postings[t];
+            if (ids.empty() || ids.back() != id) ids.push_back(id);
         }
+        count(kinds, d.kind);
+        if (!d.category.empty()) count(categories, d.category);
     }
-    f << "</div>\n";
-    
-    f << "<div class=\"grid\" id=\"items\">\n";
     
-    for (const auto& d : defs) {
-        string searchText = d.name + " " + d.desc;
-        for (const auto& t : d.tags) searchText += " " + t;
-        
-        f << "<div class=\"card\" data-type=\"" << d.kind << "\" data-category=\"" << escape(d.category) << "\" data-name=\"" << escape(d.name) << "\"";
-        f << " data-search=\"" << escape(searchText) << "\">\n";
-        
-        f << "<div class=\"card-header\">\n";
-        f << "<span class=\"badge badge-" << d.kind << "\">" << d.kind << "</span>\n";
-        if (!d.deprecated.empty()) f << "<span class=\"deprecated-badge\">deprecated</span>\n";
-        f << "</div>\n";
-        
-        f << "<div class=\"card-title\"><a href=\"" << d.name << ".html\">" << escape(d.name) << "</a></div>\n";
-        if (!d.desc.empty()) f << "<div class=\"card-desc\">" << escape(d.desc) << "</div>\n";
-        
-        if (!d.category.empty() || !d.version.empty() || !d.since.empty()) {
-            f << "<div class=\"meta-info\">\n";
-            if (!d.category.empty()) f << "<span>📁 " << escape(d.category) << "</span>\n";
-            if (!d.version.empty()) f << "<span>v" << escape(d.version) << "</span>\n";
-            if (!d.since.empty()) f << "<span>Since " << escape(d.since) << "</span>\n";
-            f << "</div>\n";
-        }
+    void render(Out& f) const {
+        Phase phase("search index");
+        vector<const pair<const string, vector<uint32_t>>*> sorted;
+        for (const auto& p : postings) sorted.push_back(&p);
+        sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
         
-        if (!d.tags.empty()) {
-            f << "<div class=\"tags\">\n";
-            for (const auto& t : d.tags) f << "<span class=\"tag\">" << escape(t) << "</span>\n";
-            f << "</div>\n";
+        f << "window.SDOC_SEARCH = {\n\"terms\": [";
+        for (size_t i = 0; i < sorted.size(); i++) f << (i ? "," : "") << '"' << sorted[i]->first << '"';
+        f << "],\n\"postings\": [";
+        for (size_t i = 0; i < sorted.size(); i++) {
+            f << (i ? ",[" : "[");
+            uint32_t prev = 0;
+            for (size_t k = 0; k < sorted[i]->second.size(); k++) {
+                uint32_t id = sorted[i]->second[k];
+                f << (k ? "," : "") << id - prev;
+                prev = id;
+            }
+            f << "]";
         }
-        
-        f << "</div>\n";
+        f << "],\n\"kinds\": {";
+        for (auto it = kinds.begin(); it != kinds.end(); ++it) f << (it == kinds.begin() ? "" : ",") << jsString(it->first) << ":" << it->second;
+        f << "},\n\"categories\": {";
+        for (auto it = categories.begin(); it != categories.end(); ++it) f << (it == categories.begin() ? "" : ",") << jsString(it->first) << ":" << it->second;
+        f << "}\n};\n";
     }
     
-    f << "</div>\n";
-    f << "<div class=\"no-results\" id=\"no-results\" style=\"display: none;\">\n";
-    f << "<h3>No results found</h3>\n<p>Try adjusting your search or filters</p>\n</div>\n";
-    f << "</div>\n";
-    
-    f << R"(<script>
-let currentType = 'all', currentCategory = '', currentView = 'grid';
+    void save(const string& outdir) const {
+        Out& f = threadBuffer();
+        render(f);
+        f.publish(outdir + "/search-index.js");
+    }
+};
+
+void renderSearchIndex(Out& f, const vector<Def>& defs) {
+    SearchIndex index;
+    for (uint32_t id = 0; id < defs.size(); id++) index.add(id, defs[id]);
+    index.render(f);
+}
+
+void generateSearchIndex(const vector<Def>& defs, const string& outdir) {
+    Out& f = threadBuffer();
+    renderSearchIndex(f, defs);
+    f.publish(outdir + "/search-index.js");
+}
+
+const char* indexScript() {
+    return R"(let currentType = 'all', currentCategory = '', currentView = 'grid';
+const items = document.getElementById('items');
+let index = window.SDOC_SEARCH, hits = [];
 
 function setView(view) {
     currentView = view;
-    const items = document.getElementById('items');
-    items.className = view === 'grid' ? 'grid' : 'list-view';
+    items.classList.toggle('grid', view === 'grid');
+    items.classList.toggle('list-view', view !== 'grid');
     document.querySelectorAll('.view-btn').forEach(btn => {
         btn.classList.toggle('active', btn.textContent.toLowerCase() === view);
     });
@@ -519,90 +2014,512 @@ function filterByCategory(cat) {
     event.target.classList.add('active');
 }
 
-function filterItems() {
-    const search = document.getElementById('search').value.toLowerCase();
-    const items = document.querySelectorAll('.card');
-    let visible = 0;
-    
-    items.forEach(item => {
-        const type = item.getAttribute('data-type');
-        const category = item.getAttribute('data-category');
-        const searchText = item.getAttribute('data-search').toLowerCase();
-        
-        const matchType = currentType === 'all' || type === currentType;
-        const matchCategory = !currentCategory || category === currentCategory;
-        const matchSearch = !search || searchText.includes(search);
-        
-        if (matchType && matchCategory && matchSearch) {
-            item.style.display = 'block';
-            visible++;
-        } else {
-            item.style.display = 'none';
-        }
-    });
-    
-    document.getElementById('no-results').style.display = visible === 0 ? 'block' : 'none';
+function queryWords() {
+    return document.getElementById('search').value.toLowerCase().split(/[^a-z0-9_]+/).filter(w => w);
 }
-</script>
-)";
-    
-    f << "</body>\n</html>\n";
+
+function lookup(word) {
+    const terms = index.terms, ids = new Set();
+    let lo = 0, hi = terms.length;
+    while (lo < hi) {
+        const mid = (lo + hi) >> 1;
+        if (terms[mid] < word) lo = mid + 1; else hi = mid;
+    }
+    for (let i = lo; i < terms.length && terms[i].startsWith(word); i++) {
+        let id = 0;
+        for (const delta of index.postings[i]) ids.add(id += delta);
+    }
+    return ids;
 }
 
-void generatePage(const Def& def, const map<string, string>& nameMap, const string& outdir, const vector<Def>& allDefs) {
-    ofstream f(outdir + "/" + def.name + ".html");
-    
-    map<string, vector<string>> categories;
-    for (const auto& d : allDefs) {
-        string cat = d.category.empty() ? "General" : d.category;
-        categories[cat].push_back(d.name);
+function search(words) {
+    let ids = null;
+    for (const word of words) {
+        const found = lookup(word);
+        ids = ids === null ? found : new Set([...ids].filter(id => found.has(id)));
     }
-    
+    return ids;
+}
+
+function cssString(s) {
+    return s.replace(/["\\]/g, '\\$&');
+}
+
+function applyFilterRule() {
+    let rule = '';
+    if (currentType !== 'all') rule = `#items .card:not([data-type="${cssString(currentType)}"]) { display: none; }`;
+    else if (currentCategory) rule = `#items .card:not([data-category="${cssString(currentCategory)}"]) { display: none; }`;
+    document.getElementById('filter-rule').textContent = rule;
+}
+)";
+}
+
+// D is a Def or, in a streaming build, an Entry.
+template <class D> void indexHeader(Out& f, const vector<D>& defs, const Style& style) {
+    set<string_view> allCategories;
+    map<string_view, int> kindCount;
+    for (const auto& d : defs) {
+        if (!d.category.empty()) allCategories.insert(d.category);
+        kindCount[d.kind]++;
+    }
+    
     f << "<!DOCTYPE html>\n<html lang=\"en\">\n<head>\n<meta charset=\"UTF-8\">\n<meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">\n";
-    f << "<title>" << escape(def.name) << " - SDOC Documentation</title>\n<style>\n" << getStyle() << "</style>\n</head>\n<body>\n";
-    f << "<div class=\"container\">\n<div class=\"two-column\">\n";
+    f << "<title>API Documentation</title>\n";
+    styleTag(f, style);
+    f << "<style id=\"filter-rule\"></style>\n</head>\n<body>\n";
+    f << "<div class=\"container\">\n";
+    f << "<div class=\"header\">\n<h1>API Documentation</h1>\n<div class=\"subtitle\">Complete reference for all types and functions</div>\n";
+    f << "<div class=\"stats\">\n";
+    f << "<span class=\"stat-item\">📦 " << defs.size() << " Total Items</span>\n";
+    for (const auto& kc : kindCount) {
+        f << "<span class=\"stat-item\">" << kc.second << " " << kc.first << "</span>\n";
+    }
+    f << "</div>\n</div>\n";
+    
+    f << "<div class=\"search-container\">\n";
+    f << "<input type=\"text\" class=\"search-box\" id=\"search\" placeholder=\"Search by name, description, or tags...\" onkeyup=\"filterItems()\">\n";
+    f << "<div class=\"view-toggle\">\n";
+    f << "<button class=\"view-btn active\" onclick=\"setView('grid')\">Grid</button>\n";
+    f << "<button class=\"view-btn\" onclick=\"setView('list')\">List</button>\n";
+    f << "</div>\n</div>\n";
+    
+    f << "<div class=\"filters\">\n";
+    f << "<button class=\"filter-btn active\" onclick=\"filterByType('all')\">All</button>\n";
+    for (const auto& kc : kindCount) {
+        f << "<button class=\"filter-btn\" onclick=\"filterByType('" << kc.first << "')\">" << kc.first << "</button>\n";
+    }
+    if (!allCategories.empty()) {
+        f << "<span style=\"color: #30363d; margin: 0 5px;\">|</span>\n";
+        for (const auto& cat : allCategories) {
+            f << "<button class=\"filter-btn\" onclick=\"filterByCategory('" << esc(cat) << "')\">" << esc(cat) << "</button>\n";
+        }
+    }
+    f << "</div>\n";
+    
+}
+
+void indexCard(Out& f, const Def& d) {
+    f << "<div class=\"card\" data-type=\"" << d.kind << "\" data-category=\"" << esc(d.category) << "\" data-name=\"" << esc(d.name) << "\">\n";
+    
+    f << "<div class=\"card-header\">\n";
+    f << "<span class=\"badge badge-" << d.kind << "\">" << d.kind << "</span>\n";
+    if (!d.deprecated.empty()) f << "<span class=\"deprecated-badge\">deprecated</span>\n";
+    f << "</div>\n";
+    
+    f << "<div class=\"card-title\"><a href=\"" << page(d.name) << "\">" << esc(d.name) << "</a></div>\n";
+    if (!d.desc.empty()) f << "<div class=\"card-desc\">" << esc(d.desc) << "</div>\n";
+    
+    if (!d.category.empty() || !d.version.empty() || !d.since.empty()) {
+        f << "<div class=\"meta-info\">\n";
+        if (!d.category.empty()) f << "<span>📁 " << esc(d.category) << "</span>\n";
+        if (!d.version.empty()) f << "<span>v" << esc(d.version) << "</span>\n";
+        if (!d.since.empty()) f << "<span>Since " << esc(d.since) << "</span>\n";
+        f << "</div>\n";
+    }
+    
+    if (!d.tags.empty()) {
+        f << "<div class=\"tags\">\n";
+        for (const auto& t : d.tags) f << "<span class=\"tag\">" << esc(t) << "</span>\n";
+        f << "</div>\n";
+    }
+    
+    f << "</div>\n";
+}
+
+void indexFooter(Out& f) {
+    f << "<div class=\"no-results\" id=\"no-results\" style=\"display: none;\">\n";
+    f << "<h3>No results found</h3>\n<p>Try adjusting your search or filters</p>\n</div>\n";
+    f << "</div>\n";
+}
+
+void indexTail(Out& f) {
+    f << "</div>\n";
+    indexFooter(f);
+    
+    f << "<script src=\"search-index.js\"></script>\n";
+    f << "<script>\n" << indexScript() << R"(const cards = items.children;
+
+function filterItems() {
+    const ids = search(queryWords());
+    
+    hits.forEach(card => card.classList.remove('hit'));
+    hits = ids === null ? [] : [...ids].map(id => cards[id]);
+    hits.forEach(card => card.classList.add('hit'));
+    items.classList.toggle('searching', ids !== null);
+    applyFilterRule();
+    
+    const matchType = card => currentType === 'all' || card.getAttribute('data-type') === currentType;
+    const matchCategory = card => !currentCategory || card.getAttribute('data-category') === currentCategory;
+    let visible;
+    if (ids !== null) visible = hits.filter(card => matchType(card) && matchCategory(card)).length;
+    else if (currentType !== 'all') visible = index.kinds[currentType] || 0;
+    else if (currentCategory) visible = index.categories[currentCategory] || 0;
+    else visible = cards.length;
+    
+    document.getElementById('no-results').style.display = visible === 0 ? 'block' : 'none';
+}
+</script>
+)";
     
-    f << "<div class=\"sidebar\">\n";
-    f << "<div class=\"sidebar-title\">Navigation</div>\n";
-    f << "<ul class=\"sidebar-list\">\n<li><a href=\"index.html\">← Back to Index</a></li>\n</ul>\n";
+    f << "</body>\n</html>\n";
+}
+
+void renderIndex(Out& f, const vector<Def>& defs, const Style& style) {
+    Phase phase("index");
+    indexHeader(f, defs, style);
+    f << "<div class=\"grid\" id=\"items\">\n";
+    for (const auto& d : defs) indexCard(f, d);
+    indexTail(f);
+}
+
+void generateIndex(const vector<Def>& defs, const string& outdir, const Style& style) {
+    Out& f = threadBuffer();
+    renderIndex(f, defs, style);
+    f.publish(outdir + "/index.html");
+}
+
+void saveShard(const string& dataDir, size_t k, Out& cards) {
+    if (Output::minify) cards.minify();
+    char name[32];
+    snprintf(name, sizeof(name), "/shard-%04zu.js", k);
+    Out& f = threadBuffer();
+    f << "sdocShard(" << k << ", " << jsString(cards.str()) << ");\n";
+    f.publish(dataDir + name);
+}
+
+void removeShards(const string& dataDir, size_t from) {
+    for (const auto& e : filesystem::directory_iterator(dataDir)) {
+        unsigned k;
+        if (sscanf(e.path().filename().c_str(), "shard-%u.js", &k) == 1 && k >= from) filesystem::remove(e.path());
+    }
+}
+
+void removeCompressed(const string& outdir) {
+    for (const string& dir : { outdir, outdir + "/index-data" }) {
+        if (!filesystem::is_directory(dir)) continue;
+        for (const auto& e : filesystem::directory_iterator(dir)) {
+            if (e.path().extension() == ".gz") filesystem::remove(e.path());
+        }
+    }
+}
+
+// The run table marks where (kind, category) changes in card order.
+template <class D> void shardedIndexPage(Out& f, const vector<D>& sorted, const Style& style, size_t shardSize) {
+    size_t shards = (sorted.size() + shardSize - 1) / shardSize;
+    indexHeader(f, sorted, style);
+    f << "<div class=\"grid\" id=\"items\">\n";
+    for (size_t k = 0; k < shards; k++) f << "<div class=\"shard\" id=\"shard-" << k << "\"></div>\n";
+    f << "</div>\n";
+    f << "<div id=\"more\"></div>\n";
+    indexFooter(f);
+
+    f << "<script>\nconst SDOC_SHARDS = {\"size\": " << shardSize << ", \"total\": " << sorted.size() << ", \"runs\": [";
+    for (size_t i = 0; i < sorted.size(); i++) {
+        if (i > 0 && sorted[i].kind == sorted[i - 1].kind && sorted[i].category == sorted[i - 1].category) continue;
+        f << (i ? "," : "") << "[" << i << "," << jsString(string(sorted[i].kind)) << "," << jsString(string(sorted[i].category)) << "]";
+    }
+    f << "]};\n" << indexScript() << R"(const loaded = [], requested = new Set();
+let ids = null;
+
+function runAt(id) {
+    const runs = SDOC_SHARDS.runs;
+    let lo = 0, hi = runs.length - 1;
+    while (lo < hi) {
+        const mid = (lo + hi + 1) >> 1;
+        if (runs[mid][0] <= id) lo = mid; else hi = mid - 1;
+    }
+    return lo;
+}
+
+function runMatches(run) {
+    return (currentType === 'all' || run[1] === currentType) && (!currentCategory || run[2] === currentCategory);
+}
+
+function shardWanted(k) {
+    const runs = SDOC_SHARDS.runs;
+    const first = k * SDOC_SHARDS.size, last = Math.min(SDOC_SHARDS.total, first + SDOC_SHARDS.size) - 1;
+    for (let i = runAt(first); i < runs.length && runs[i][0] <= last; i++) {
+        if (runMatches(runs[i])) return true;
+    }
+    return false;
+}
+
+function loadMore() {
+    const shards = Math.ceil(SDOC_SHARDS.total / SDOC_SHARDS.size);
+    for (let k = 0; k < shards; k++) {
+        if (requested.has(k) || !shardWanted(k)) continue;
+        requested.add(k);
+        const script = document.createElement('script');
+        script.src = `index-data/shard-${String(k).padStart(4, '0')}.js`;
+        document.body.appendChild(script);
+        return;
+    }
+}
+
+function markHits(k) {
+    const first = k * SDOC_SHARDS.size;
+    Array.from(loaded[k]).forEach((card, i) => {
+        const hit = ids !== null && ids.has(first + i);
+        card.classList.toggle('hit', hit);
+        if (hit) hits.push(card);
+    });
+}
+
+window.sdocShard = (k, html) => {
+    const shard = document.getElementById('shard-' + k);
+    shard.innerHTML = html;
+    loaded[k] = shard.children;
+    markHits(k);
+    if (more.getBoundingClientRect().top < window.innerHeight) loadMore();
+};
+
+function loadSearchIndex(then) {
+    const script = document.createElement('script');
+    script.src = 'search-index.js';
+    script.onload = () => { index = window.SDOC_SEARCH; then(); };
+    document.body.appendChild(script);
+}
+
+function filterItems() {
+    const words = queryWords();
+    if (words.length && !index) return loadSearchIndex(filterItems);
+    ids = index ? search(words) : null;
+
+    hits.forEach(card => card.classList.remove('hit'));
+    hits = [];
+    loaded.forEach((cards, k) => markHits(k));
+    items.classList.toggle('searching', ids !== null);
+    applyFilterRule();
+
+    let visible = 0;
+    if (ids !== null) ids.forEach(id => { if (runMatches(SDOC_SHARDS.runs[runAt(id)])) visible++; });
+    else SDOC_SHARDS.runs.forEach((run, i) => {
+        const end = i + 1 < SDOC_SHARDS.runs.length ? SDOC_SHARDS.runs[i + 1][0] : SDOC_SHARDS.total;
+        if (runMatches(run)) visible += end - run[0];
+    });
+
+    document.getElementById('no-results').style.display = visible === 0 ? 'block' : 'none';
+    loadMore();
+}
+
+const more = document.getElementById('more');
+new IntersectionObserver(entries => { if (entries[0].isIntersecting) loadMore(); }).observe(more);
+loadMore();
+</script>
+)";
+
+    f << "</body>\n</html>\n";
+}
+
+// Cards grouped by (kind, category) in index-data/shard-NNNN.js files, fetched as the list scrolls.
+void generateShardedIndex(const vector<Def>& defs, const string& outdir, const Style& style, size_t shardSize) {
+    Phase phase("index");
+    vector<Def> sorted(defs);
+    stable_sort(sorted.begin(), sorted.end(), [](const Def& a, const Def& b) {
+        return a.kind != b.kind ? a.kind < b.kind : a.category < b.category;
+    });
+    size_t shards = (sorted.size() + shardSize - 1) / shardSize;
+
+    string dataDir = outdir + "/index-data";
+    filesystem::create_directories(dataDir);
+    Out cards;
+    for (size_t k = 0; k < shards; k++) {
+        cards.clear();
+        for (size_t i = k * shardSize; i < min(sorted.size(), (k + 1) * shardSize); i++) indexCard(cards, sorted[i]);
+        saveShard(dataDir, k, cards);
+    }
+    removeShards(dataDir, shards);
+    generateSearchIndex(sorted, outdir);
+
+    Out& f = threadBuffer();
+    shardedIndexPage(f, sorted, style, shardSize);
+    f.publish(outdir + "/index.html");
+}
+
+struct Sidebar {
+    bool shared = false;
+    string html;
+    map<string, vector<size_t>, less<>> current;
+};
+
+template <class D> Sidebar buildSidebar(const vector<D>& defs, bool shared) {
+    Phase phase("sidebar");
+    map<string_view, vector<string_view>> categories;
+    for (const auto& d : defs) {
+        categories[d.category.empty() ? "General" : d.category].push_back(d.name);
+    }
     
+    Sidebar nav;
+    nav.shared = shared;
+    string& h = nav.html;
+    h += "<div class=\"sidebar-title\">Navigation</div>\n";
+    h += "<ul class=\"sidebar-list\">\n<li><a href=\"index.html\">← Back to Index</a></li>\n</ul>\n";
     for (const auto& cat : categories) {
-        f << "<div class=\"sidebar-title\" style=\"margin-top: 20px;\">" << escape(cat.first) << "</div>\n";
-        f << "<ul class=\"sidebar-list\">\n";
+        h += "<div class=\"sidebar-title\" style=\"margin-top: 20px;\">" + escape(cat.first) + "</div>\n";
+        h += "<ul class=\"sidebar-list\">\n";
         for (const auto& name : cat.second) {
-            string cls = (name == def.name) ? " class=\"current\"" : "";
-            f << "<li><a href=\"" << name << ".html\"" << cls << ">" << escape(name) << "</a></li>\n";
+            h += "<li><a href=\"";
+            appendPagePath(h, name);
+            h += '"';
+            if (!shared) nav.current[string(name)].push_back(h.size());
+            h += '>';
+            appendEscaped(h, name);
+            // Every page would strip the newline again when minifying.
+            h += Output::minify ? "</a></li>" : "</a></li>\n";
         }
-        f << "</ul>\n";
+        h += "</ul>\n";
+    }
+    return nav;
+}
+
+void renderNav(Out& f, const Sidebar& nav) {
+    f << "(function() {\n";
+    f << "const el = document.currentScript.parentNode;\n";
+    f << "const current = el.getAttribute('data-current');\n";
+    string html = nav.html;
+    if (Output::minify) minifyHtml(html);
+    f << "el.innerHTML = " << jsString(html) << ";\n";
+    f << "el.querySelectorAll('.sidebar-list a').forEach(a => {\n";
+    f << "    if (a.getAttribute('href') === current) a.className = 'current';\n";
+    f << "});\n";
+    f << "})();\n";
+}
+
+void generateNav(const Sidebar& nav, const string& outdir) {
+    Out& f = threadBuffer();
+    renderNav(f, nav);
+    f.publish(outdir + "/nav.js");
+}
+
+// How one definition refers to another; a Use may combine several.
+enum UseKind : uint8_t { USE_RETURN = 1, USE_FIELD = 2, USE_LINK = 4 };
+
+template <class F> void forEachRef(const Def& d, const F& fn) {
+    for (const auto& t : d.retRefs) if (t.sym >= 0) fn(t.sym, USE_RETURN);
+    for (const auto& f : d.fields) {
+        for (const auto& t : f.typeRefs) if (t.sym >= 0) fn(t.sym, USE_FIELD);
+    }
+    for (auto sym : d.linkRefs) if (sym >= 0) fn(sym, USE_LINK);
+}
+
+// Reverse references, sorted into adjacency arrays by counting.
+class UsageGraph {
+public:
+    struct Use {
+        uint32_t from;
+        uint8_t how;
+    };
+
+private:
+    struct Edge {
+        uint32_t to, from;
+        uint8_t how;
+    };
+
+    vector<Edge> edges;
+    vector<uint32_t> start;
+    vector<Use> uses;
+
+public:
+    void add(uint32_t from, int32_t to, uint8_t how) {
+        if (to >= 0 && (uint32_t)to != from) edges.push_back({ (uint32_t)to, from, how });
     }
     
-    f << "</div>\n";
+    void add(uint32_t from, const Def& d) {
+        forEachRef(d, [&](int32_t to, uint8_t how) { add(from, to, how); });
+    }
+
+    // Definitions must have been added in increasing order of id.
+    void finish(size_t n) {
+        Phase phase("xref");
+        start.assign(n + 1, 0);
+        for (const auto& e : edges) start[e.to + 1]++;
+        for (size_t i = 0; i < n; i++) start[i + 1] += start[i];
+        uses.resize(edges.size());
+        vector<uint32_t> at(start.begin(), start.end() - 1);
+        for (const auto& e : edges) uses[at[e.to]++] = { e.from, e.how };
+        edges = vector<Edge>();
+
+        // Edges from one user are adjacent; merge them into one Use.
+        uint32_t w = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint32_t r = start[i], end = start[i + 1];
+            start[i] = w;
+            while (r < end) {
+                Use u = uses[r++];
+                while (r < end && uses[r].from == u.from) u.how |= uses[r++].how;
+                uses[w++] = u;
+            }
+        }
+        start[n] = w;
+        uses.resize(w);
+        uses.shrink_to_fit();
+    }
+
+    Span<Use> operator[](size_t i) const {
+        if (i + 1 >= start.size()) return {};
+        return { uses.data() + start[i], start[i + 1] - start[i] };
+    }
+
+    size_t size() const { return uses.size(); }
+};
+
+struct UsedBy {
+    Span<UsageGraph::Use> uses;
+    const Entry* entries = nullptr;
+};
+
+void renderPage(Out& f, const Def& def, const Sidebar& nav, const Style& style, const UsedBy& used = {}) {
+    f << "<!DOCTYPE html>\n<html lang=\"en\">\n<head>\n<meta charset=\"UTF-8\">\n<meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">\n";
+    f << "<title>" << esc(def.name) << " - SDOC Documentation</title>\n";
+    // Links are relative to the output directory, not the page's subdirectory.
+    if (Output::pageDirs) f << "<base href=\"../\">\n";
+    styleTag(f, style);
+    f << "</head>\n<body>\n";
+    f << "<div class=\"container\">\n<div class=\"two-column\">\n";
+    
+    if (nav.shared) {
+        f << "<div class=\"sidebar\" data-current=\"" << page(def.name) << "\"><script src=\"nav.js\"></script></div>\n";
+    } else {
+        f << "<div class=\"sidebar\">\n";
+        size_t at = 0;
+        auto it = nav.current.find(def.name);
+        if (it != nav.current.end()) {
+            for (size_t off : it->second) {
+                f.write(nav.html.data() + at, off - at);
+                f << " class=\"current\"";
+                at = off;
+            }
+        }
+        f.write(nav.html.data() + at, nav.html.size() - at);
+        f << "</div>\n";
+    }
     
     f << "<div class=\"detail-page\">\n";
     f << "<div class=\"detail-header\">\n";
-    f << "<div class=\"detail-title\">\n" << escape(def.name) << " <span class=\"badge badge-" << def.kind << "\">" << def.kind << "</span>\n";
+    f << "<div class=\"detail-title\">\n" << esc(def.name) << " <span class=\"badge badge-" << def.kind << "\">" << def.kind << "</span>\n";
     if (!def.deprecated.empty()) f << "<span class=\"deprecated-badge\">deprecated</span>\n";
     f << "</div>\n";
     
-    if (!def.desc.empty()) f << "<div class=\"detail-desc\">" << escape(def.desc) << "</div>\n";
+    if (!def.desc.empty()) f << "<div class=\"detail-desc\">" << esc(def.desc) << "</div>\n";
     
     if (!def.deprecated.empty() && def.deprecated != "true") {
         f << "<div class=\"note-block\" style=\"border-left-color: #da3633; background: #2d1417;\">\n";
-        f << "<strong>⚠️ Deprecated:</strong> " << escape(def.deprecated) << "\n</div>\n";
+        f << "<strong>⚠️ Deprecated:</strong> " << esc(def.deprecated) << "\n</div>\n";
     }
     
     if (!def.category.empty() || !def.version.empty() || !def.author.empty() || !def.since.empty()) {
         f << "<div class=\"meta-info\" style=\"margin-top: 15px;\">\n";
-        if (!def.category.empty()) f << "<span class=\"category-badge\">" << escape(def.category) << "</span>\n";
-        if (!def.version.empty()) f << "<span>Version: " << escape(def.version) << "</span>\n";
-        if (!def.since.empty()) f << "<span>Since: " << escape(def.since) << "</span>\n";
-        if (!def.author.empty()) f << "<span>Author: " << escape(def.author) << "</span>\n";
+        if (!def.category.empty()) f << "<span class=\"category-badge\">" << esc(def.category) << "</span>\n";
+        if (!def.version.empty()) f << "<span>Version: " << esc(def.version) << "</span>\n";
+        if (!def.since.empty()) f << "<span>Since: " << esc(def.since) << "</span>\n";
+        if (!def.author.empty()) f << "<span>Author: " << esc(def.author) << "</span>\n";
         f << "</div>\n";
     }
     
     if (!def.tags.empty()) {
         f << "<div class=\"tags\" style=\"margin-top: 15px;\">\n";
-        for (const auto& t : def.tags) f << "<span class=\"tag\">" << escape(t) << "</span>\n";
+        for (const auto& t : def.tags) f << "<span class=\"tag\">" << esc(t) << "</span>\n";
         f << "</div>\n";
     }
     
@@ -610,7 +2527,7 @@ void generatePage(const Def& def, const map<string, string>& nameMap, const stri
     
     if (!def.ret.empty()) {
         f << "<div class=\"section\">\n<div class=\"section-title\">Returns</div>\n";
-        f << "<div class=\"returns-box\"><span class=\"type\">" << linkify(def.ret, nameMap) << "</span></div>\n</div>\n";
+        f << "<div class=\"returns-box\"><span class=\"type\">" << linkify(def.retRefs) << "</span></div>\n</div>\n";
     }
     
     if (!def.fields.empty()) {
@@ -618,17 +2535,18 @@ void generatePage(const Def& def, const map<string, string>& nameMap, const stri
         f << "<table class=\"field-table\">\n<thead>\n<tr><th>Name</th><th>Type</th><th>Description</th><th>Default</th></tr>\n</thead>\n<tbody>\n";
         for (const auto& field : def.fields) {
             f << "<tr>\n";
-            f << "<td><span class=\"name\">" << escape(field.name) << "</span>";
+            f << "<td><span class=\"name\">" << esc(field.name) << "</span>";
             if (field.required) f << "<span class=\"required-badge\">REQUIRED</span>";
             if (!field.tags.empty()) {
                 f << "<div class=\"tags\" style=\"margin-top: 5px;\">";
-                for (const auto& t : field.tags) f << "<span class=\"tag\">" << escape(t) << "</span> ";
+                for (const auto& t : field.tags) f << "<span class=\"tag\">" << esc(t) << "</span> ";
                 f << "</div>";
             }
             f << "</td>\n";
-            f << "<td><span class=\"type\">" << linkify(field.type, nameMap) << "</span></td>\n";
-            f << "<td>" << escape(field.desc) << "</td>\n";
-            f << "<td>" << (field.defval.empty() ? "-" : "<span class=\"default\">" + escape(field.defval) + "</span>") << "</td>\n";
+            f << "<td><span class=\"type\">" << linkify(field.typeRefs) << "</span></td>\n";
+            f << "<td>" << esc(field.desc) << "</td>\n";
+            if (field.defval.empty()) f << "<td>-</td>\n";
+            else f << "<td><span class=\"default\">" << esc(field.defval) << "</span></td>\n";
             f << "</tr>\n";
         }
         f << "</tbody>\n</table>\n</div>\n";
@@ -637,7 +2555,7 @@ void generatePage(const Def& def, const map<string, string>& nameMap, const stri
     if (!def.examples.empty()) {
         f << "<div class=\"section\">\n<div class=\"section-title\">Examples</div>\n";
         for (const auto& ex : def.examples) {
-            f << "<div class=\"example-block\">\n<pre>" << escape(ex) << "</pre>\n</div>\n";
+            f << "<div class=\"example-block\">\n<pre>" << esc(ex) << "</pre>\n</div>\n";
         }
         f << "</div>\n";
     }
@@ -645,7 +2563,7 @@ void generatePage(const Def& def, const map<string, string>& nameMap, const stri
     if (!def.notes.empty()) {
         f << "<div class=\"section\">\n<div class=\"section-title\">Notes</div>\n";
         for (const auto& note : def.notes) {
-            f << "<div class=\"note-block\">💡 " << escape(note) << "</div>\n";
+            f << "<div class=\"note-block\">💡 " << esc(note) << "</div>\n";
         }
         f << "</div>\n";
     }
@@ -653,23 +2571,37 @@ void generatePage(const Def& def, const map<string, string>& nameMap, const stri
     if (!def.links.empty()) {
         f << "<div class=\"section\">\n<div class=\"section-title\">Related Items</div>\n";
         f << "<div class=\"links-grid\">\n";
-        for (const auto& link : def.links) {
+        for (size_t i = 0; i < def.links.size(); i++) {
+            string_view link = def.links[i];
             f << "<div class=\"link-item\">";
-            if (nameMap.count(link)) {
-                f << "<a href=\"" << nameMap.at(link) << "\">" << escape(link) << "</a>";
-            } else {
-                f << escape(link);
-            }
+            if (def.linkRefs[i] >= 0) f << "<a href=\"" << page(link) << "\">" << esc(link) << "</a>";
+            else f << esc(link);
             f << "</div>\n";
         }
         f << "</div>\n</div>\n";
     }
     
+    if (!used.uses.empty()) {
+        f << "<div class=\"section\">\n<div class=\"section-title\">Used by</div>\n";
+        f << "<div class=\"links-grid\">\n";
+        for (const auto& u : used.uses) {
+            const Entry& e = used.entries[u.from];
+            f << "<div class=\"link-item\"><a href=\"" << page(e.name) << "\">" << esc(e.name) << "</a> <span class=\"badge badge-" << e.kind << "\">" << e.kind << "</span>";
+            f << "<span class=\"used-as\">";
+            const char* sep = "";
+            if (u.how & USE_RETURN) { f << "returns it"; sep = ", "; }
+            if (u.how & USE_FIELD) { f << sep << "field type"; sep = ", "; }
+            if (u.how & USE_LINK) f << sep << "links to it";
+            f << "</span></div>\n";
+        }
+        f << "</div>\n</div>\n";
+    }
+    
     if (!def.meta.empty()) {
         f << "<div class=\"section\">\n<div class=\"section-title\">Additional Metadata</div>\n";
         f << "<table class=\"field-table\">\n<tbody>\n";
         for (const auto& m : def.meta) {
-            f << "<tr><td style=\"width: 200px;\"><strong>" << escape(m.first) << "</strong></td><td>" << escape(m.second) << "</td></tr>\n";
+            f << "<tr><td style=\"width: 200px;\"><strong>" << esc(m.first) << "</strong></td><td>" << esc(m.second) << "</td></tr>\n";
         }
         f << "</tbody>\n</table>\n</div>\n";
     }
@@ -677,52 +2609,1910 @@ void generatePage(const Def& def, const map<string, string>& nameMap, const stri
     f << "</div>\n</div>\n</div>\n</body>\n</html>\n";
 }
 
-int main(int argc, char **argv) {
-    if (argc < 3) {
-        cerr << "SDOC - Simple Documentation Generator\n";
-        cerr << "Usage: " << argv[0] << " <input_file> <output_dir>\n";
-        cerr << "Generates comprehensive HTML documentation from SDOC definition files.\n";
-        return 1;
+void generatePage(const Def& def, const string& outdir, const Sidebar& nav, const Style& style, const UsedBy& used = {}) {
+    Out& f = threadBuffer();
+    {
+        Phase phase("render");
+        renderPage(f, def, nav, style, used);
+    }
+    f.publish(outdir + "/" + pagePath(def.name));
+}
+
+// Empty strings and lists are left out.
+void renderJson(Out& f, const Def& def, string_view file) {
+    auto str = [&](const char* key, string_view v) {
+        if (!v.empty()) f << ",\"" << key << "\":" << json(v);
+    };
+    auto list = [&](const char* key, Span<string_view> v) {
+        if (v.empty()) return;
+        f << ",\"" << key << "\":[";
+        for (size_t i = 0; i < v.size(); i++) f << (i ? "," : "") << json(v[i]);
+        f << ']';
+    };
+    auto refs = [&](const char* key, Span<TypeToken> v) {
+        size_t n = 0;
+        for (const auto& t : v) {
+            if (t.sym < 0) continue;
+            if (n++ == 0) f << ",\"" << key << "\":[";
+            else f << ',';
+            f << json(t.text);
+        }
+        if (n) f << ']';
+    };
+
+    f << "{\"name\":" << json(def.name) << ",\"kind\":" << json(def.kind);
+    str("file", file);
+    str("desc", def.desc);
+    str("category", def.category);
+    str("version", def.version);
+    str("since", def.since);
+    str("author", def.author);
+    str("deprecated", def.deprecated);
+    list("tags", def.tags);
+    str("returns", def.ret);
+    refs("returnRefs", def.retRefs);
+    if (!def.fields.empty()) {
+        f << ",\"fields\":[";
+        for (size_t i = 0; i < def.fields.size(); i++) {
+            const Field& field = def.fields[i];
+            f << (i ? ",{" : "{") << "\"name\":" << json(field.name) << ",\"type\":" << json(field.type);
+            refs("typeRefs", field.typeRefs);
+            str("desc", field.desc);
+            str("default", field.defval);
+            if (field.required) f << ",\"required\":true";
+            list("tags", field.tags);
+            f << '}';
+        }
+        f << ']';
+    }
+    if (!def.links.empty()) {
+        f << ",\"links\":[";
+        for (size_t i = 0; i < def.links.size(); i++) {
+            bool resolved = i < def.linkRefs.size() && def.linkRefs[i] >= 0;
+            f << (i ? ",{" : "{") << "\"name\":" << json(def.links[i]) << ",\"resolved\":" << (resolved ? "true}" : "false}");
+        }
+        f << ']';
+    }
+    list("examples", def.examples);
+    list("notes", def.notes);
+    if (!def.meta.empty()) {
+        f << ",\"meta\":{";
+        for (size_t i = 0; i < def.meta.size(); i++) f << (i ? "," : "") << json(def.meta[i].first) << ':' << json(def.meta[i].second);
+        f << '}';
     }
+    f << '}';
+}
+
+class ThreadPool {
+    struct Queue { mutex m; deque<size_t> items; };
     
-    ifstream inFile(argv[1]);
-    if (!inFile) {
-        cerr << "Error: Cannot open input file '" << argv[1] << "'\n";
-        return 1;
+    vector<unique_ptr<Queue>> queues;
+    vector<thread> threads;
+    mutex m;
+    condition_variable wake, done;
+    const function<void(size_t)>* job = nullptr;
+    size_t generation = 0;
+    atomic<size_t> remaining{0};
+    exception_ptr error;
+    bool stopping = false;
+    
+    bool take(size_t self, size_t& item) {
+        {
+            Queue& q = *queues[self];
+            lock_guard<mutex> l(q.m);
+            if (!q.items.empty()) { item = q.items.back(); q.items.pop_back(); return true; }
+        }
+        for (size_t k = 1; k < queues.size(); k++) {
+            Queue& q = *queues[(self + k) % queues.size()];
+            lock_guard<mutex> l(q.m);
+            if (!q.items.empty()) { item = q.items.front(); q.items.pop_front(); return true; }
+        }
+        return false;
     }
     
-    stringstream buffer;
-    buffer << inFile.rdbuf();
-    string input = buffer.str();
-    inFile.close();
+    void work(size_t self) {
+        size_t item;
+        while (take(self, item)) {
+            try { (*job)(item); }
+            catch (...) { lock_guard<mutex> l(m); if (!error) error = current_exception(); }
+            if (--remaining == 0) { lock_guard<mutex> l(m); done.notify_all(); }
+        }
+    }
     
-    string outdir = argv[2];
+    void loop(size_t self) {
+        size_t seen = 0;
+        for (;;) {
+            {
+                unique_lock<mutex> l(m);
+                wake.wait(l, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            work(self);
+        }
+    }
     
-    try {
-        Parser p(input);
-        auto defs = p.parse();
-        
-        if (defs.empty()) {
-            cerr << "Warning: No definitions found in input file\n";
-            return 1;
+public:
+    explicit ThreadPool(size_t n) {
+        if (n == 0) n = 1;
+        for (size_t i = 0; i < n; i++) queues.push_back(make_unique<Queue>());
+        for (size_t i = 1; i < n; i++) threads.emplace_back(&ThreadPool::loop, this, i);
+    }
+    
+    ~ThreadPool() {
+        { lock_guard<mutex> l(m); stopping = true; }
+        wake.notify_all();
+        for (auto& t : threads) t.join();
+    }
+    
+    size_t size() const { return queues.size(); }
+    
+    // Each worker starts on its own slice and steals once it runs dry.
+    void run(size_t count, const function<void(size_t)>& fn) {
+        if (count == 0) return;
+        size_t n = queues.size();
+        for (size_t w = 0; w < n; w++) {
+            lock_guard<mutex> l(queues[w]->m);
+            for (size_t i = count * w / n; i < count * (w + 1) / n; i++) queues[w]->items.push_back(i);
         }
-        
-        map<string, string> nameMap;
-        for (const auto& d : defs) {
-            nameMap[d.name] = d.name + ".html";
+        {
+            lock_guard<mutex> l(m);
+            job = &fn;
+            error = nullptr;
+            remaining = count;
+            generation++;
         }
-        
-        generateIndex(defs, outdir);
-        
-        for (const auto& d : defs) {
-            generatePage(d, nameMap, outdir, defs);
+        wake.notify_all();
+        work(0);
+        unique_lock<mutex> l(m);
+        done.wait(l, [&] { return remaining == 0; });
+        job = nullptr;
+        if (error) rethrow_exception(error);
+    }
+};
+
+struct Hasher {
+    uint64_t h = 14695981039346656037ULL;
+    
+    Hasher& add(uint64_t n) { h = fnv1a(string_view(reinterpret_cast<const char*>(&n), sizeof n), h); return *this; }
+    Hasher& add(string_view s) { add(s.size()); h = fnv1a(s, h); return *this; }
+    template <class T> Hasher& add(Span<T> v) { add(v.size()); for (const auto& x : v) add(x); return *this; }
+    Hasher& add(const pair<string_view, string_view>& m) { return add(m.first).add(m.second); }
+    Hasher& add(const Field& f) { return add(f.type).add(f.name).add(f.desc).add(f.defval).add(f.tags).add(f.required); }
+};
+
+uint64_t hashDef(const Def& d) {
+    Hasher h;
+    h.add(d.kind).add(d.name).add(d.desc).add(d.ret).add(d.category).add(d.version).add(d.author).add(d.since).add(d.deprecated);
+    h.add(d.fields).add(d.links).add(d.examples).add(d.notes).add(d.tags).add(d.meta);
+    return h.h;
+}
+
+uint64_t hashCard(const Def& d) {
+    Hasher h;
+    h.add(d.kind).add(d.name).add(d.desc).add(d.category).add(d.version).add(d.since).add(d.deprecated).add(d.tags);
+    h.add(d.fields.size());
+    for (const auto& f : d.fields) h.add(f.name);
+    return h.h;
+}
+
+uint64_t hashUsers(const UsedBy& used) {
+    Hasher h;
+    h.add(used.uses.size());
+    for (const auto& u : used.uses) {
+        const Entry& e = used.entries[u.from];
+        h.add(e.name).add(e.kind).add(u.how);
+    }
+    return h.h;
+}
+
+// Anything with whitespace can never be a name.
+template <class F> void forEachIdent(string_view t, const F& fn) {
+    for (size_t i = 0; i < t.size();) {
+        if (!isalnum(static_cast<unsigned char>(t[i])) && t[i] != '_') { i++; continue; }
+        size_t start = i;
+        while (i < t.size() && (isalnum(static_cast<unsigned char>(t[i])) || t[i] == '_')) i++;
+        fn(t.substr(start, i - start));
+    }
+}
+
+bool isName(string_view s) { return find_if(s.begin(), s.end(), [](unsigned char c) { return isspace(c); }) == s.end(); }
+
+vector<string_view> pageRefs(const Def& d) {
+    vector<string_view> refs;
+    auto add = [&](string_view name) { refs.push_back(name); };
+    forEachIdent(d.ret, add);
+    for (const auto& f : d.fields) forEachIdent(f.type, add);
+    for (const auto& l : d.links) {
+        if (isName(l)) refs.push_back(l);
+    }
+    sort(refs.begin(), refs.end());
+    refs.erase(unique(refs.begin(), refs.end()), refs.end());
+    return refs;
+}
+
+Style loadStyle(const string& path, bool shared) {
+    Style style;
+    style.css = path.empty() ? string(getStyle()) : string(MappedFile(path).view());
+    if (shared) {
+        char name[40];
+        snprintf(name, sizeof(name), "style.%016llx.css", (unsigned long long)fnv1a(style.css));
+        style.href = name;
+    }
+    return style;
+}
+
+// The name carries the content hash, so an existing file is up to date.
+void writeStyle(const Style& style, const string& outdir) {
+    for (const auto& e : filesystem::directory_iterator(outdir)) {
+        string name = e.path().filename().string();
+        if (name != style.href && name.compare(0, 6, "style.") == 0 && e.path().extension() == ".css") filesystem::remove(e.path());
+    }
+    if (!Output::archive && access((outdir + "/" + style.href).c_str(), F_OK) == 0) return;
+    Out& f = threadBuffer();
+    f << style.css;
+    f.publish(outdir + "/" + style.href);
+}
+
+struct Manifest {
+    struct Page { uint64_t hash = 0; vector<string> refs; };
+    
+    uint64_t config = 0, nav = 0, index = 0;
+    map<string, Page, less<>> pages;
+    
+    static constexpr const char* file = "/.sdoc-manifest";
+    
+    static Manifest load(const string& outdir) {
+        Phase phase("manifest");
+        Manifest m;
+        ifstream f(outdir + file);
+        string line;
+        if (!getline(f, line) || line != "sdoc-manifest 1") return m;
+        while (getline(f, line)) {
+            vector<string> cols;
+            size_t at = 0, tab;
+            while ((tab = line.find('\t', at)) != string::npos) { cols.push_back(line.substr(at, tab - at)); at = tab + 1; }
+            cols.push_back(line.substr(at));
+            if (cols.size() < 2) continue;
+            uint64_t h = strtoull(cols[cols[0] == "page" ? 2 : 1].c_str(), nullptr, 16);
+            if (cols[0] == "config") m.config = h;
+            else if (cols[0] == "nav") m.nav = h;
+            else if (cols[0] == "index") m.index = h;
+            else if (cols[0] == "page" && cols.size() >= 3) {
+                Page& p = m.pages[cols[1]];
+                p.hash = h;
+                p.refs.assign(cols.begin() + 3, cols.end());
+            }
         }
+        return m;
+    }
+    
+    void save(const string& outdir) const {
+        Phase phase("manifest");
+        string tmp = outdir + file + ".tmp";
+        Out& f = threadBuffer();
+        auto hex = [&](uint64_t n) {
+            char t[16];
+            f.write(t, to_chars(t, t + sizeof t, n, 16).ptr - t);
+        };
+        f << "sdoc-manifest 1\nconfig\t";
+        hex(config);
+        f << "\nnav\t";
+        hex(nav);
+        f << "\nindex\t";
+        hex(index);
+        f << "\n";
+        for (const auto& p : pages) {
+            f << "page\t" << p.first << "\t";
+            hex(p.second.hash);
+            for (const auto& r : p.second.refs) f << "\t" << r;
+            f << "\n";
+        }
+        f.save(tmp);
+        replaceFile(tmp, outdir + file);
+    }
+};
+
+// Linear probing; doubles once half full.
+class SymbolTable {
+    struct Slot { string_view name; int32_t id = -1; };
+    vector<Slot> slots;
+    size_t mask = 0, used = 0;
+    
+    void grow() {
+        vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        mask = slots.size() - 1;
+        for (const auto& s : old) {
+            if (s.id < 0) continue;
+            size_t i = fnv1a(s.name) & mask;
+            while (slots[i].id >= 0) i = (i + 1) & mask;
+            slots[i] = s;
+        }
+    }
+    
+public:
+    explicit SymbolTable(size_t n = 0) {
+        size_t cap = 16;
+        while (cap < n * 2) cap <<= 1;
+        slots.resize(cap);
+        mask = cap - 1;
+    }
+    
+    // Returns the id the name maps to afterwards.
+    int32_t insert(string_view name, int32_t id) {
+        if ((used + 1) * 2 > slots.size()) grow();
+        for (size_t i = fnv1a(name) & mask; ; i = (i + 1) & mask) {
+            if (slots[i].id < 0) { slots[i] = { name, id }; used++; return id; }
+            if (slots[i].name == name) return slots[i].id;
+        }
+    }
+    
+    int32_t find(string_view name) const {
+        for (size_t i = fnv1a(name) & mask; ; i = (i + 1) & mask) {
+            if (slots[i].id < 0 || slots[i].name == name) return slots[i].id;
+        }
+    }
+};
+
+// Types are interned, so results are cached per string.
+class Resolver {
+    const SymbolTable& symbols;
+    Arena& arena;
+    unordered_map<string_view, Span<TypeToken>> types;
+    vector<TypeToken> tokens;
+    vector<Field> fields;
+    vector<int32_t> links;
+    
+    Span<TypeToken> type(string_view t) {
+        if (t.empty()) return {};
+        auto it = types.find(t);
+        if (it != types.end()) return it->second;
+        tokens.clear();
+        size_t plain = 0;
+        for (size_t i = 0; i < t.size(); ) {
+            if (!isalnum((unsigned char)t[i]) && t[i] != '_') { i++; continue; }
+            size_t start = i;
+            while (i < t.size() && (isalnum((unsigned char)t[i]) || t[i] == '_')) i++;
+            int32_t sym = symbols.find(t.substr(start, i - start));
+            if (sym < 0) continue;
+            if (start > plain) tokens.push_back({ t.substr(plain, start - plain), -1 });
+            tokens.push_back({ t.substr(start, i - start), sym });
+            plain = i;
+        }
+        if (plain < t.size()) tokens.push_back({ t.substr(plain), -1 });
+        return types[t] = arena.list(tokens);
+    }
+    
+public:
+    Resolver(const SymbolTable& s, Arena& a) : symbols(s), arena(a) {}
+    
+    void resolve(Def& d) {
+        d.retRefs = type(d.ret);
+        fields.assign(d.fields.begin(), d.fields.end());
+        for (auto& f : fields) f.typeRefs = type(f.type);
+        d.fields = arena.list(fields);
+        links.clear();
+        for (const auto& l : d.links) links.push_back(symbols.find(l));
+        d.linkRefs = arena.list(links);
+    }
+};
+
+// defs point into its own mapping and arena; refs is replaced when relinked.
+struct Source {
+    string path;
+    unique_ptr<MappedFile> file;
+    Arena arena;
+    vector<Def> defs;
+    vector<uint64_t> hashes, cards;
+    unique_ptr<Arena> refs;
+};
+
+struct Corpus {
+    vector<unique_ptr<Source>> sources;
+    vector<Def> defs;
+    vector<const Source*> origin;
+    vector<uint64_t> hashes, cards;
+    vector<bool> stale;
+    vector<Entry> entries;
+    UsageGraph usedBy;
+    SymbolTable symbols;
+    uint64_t names = 0;
+    
+    UsedBy users(size_t i) const { return { usedBy[i], entries.data() }; }
+};
+
+vector<string> expandInputs(const vector<string>& args, bool headers = false) {
+    vector<string> files;
+    for (const auto& a : args) {
+        if (a.find_first_of("*?[") != string::npos) {
+            glob_t g;
+            if (glob(a.c_str(), 0, nullptr, &g) != 0) throw runtime_error("No input files match '" + a + "'");
+            for (size_t i = 0; i < g.gl_pathc; i++) files.push_back(g.gl_pathv[i]);
+            globfree(&g);
+        } else if (filesystem::is_directory(a)) {
+            vector<string> found;
+            for (const auto& e : filesystem::recursive_directory_iterator(a)) {
+                if (e.is_regular_file() && (e.path().extension() == ".doc" || (headers && isHeader(e.path())))) found.push_back(e.path().string());
+            }
+            sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        } else {
+            files.push_back(a);
+        }
+    }
+    set<string> seen;
+    files.erase(remove_if(files.begin(), files.end(), [&](const string& f) { return !seen.insert(f).second; }), files.end());
+    return files;
+}
+
+// .sdocb: CacheHeader, def, field, string-list and meta records, then the string table.
+struct CacheStr { uint32_t off, len; };
+struct CacheRange { uint32_t first, count; };
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version, reserved;
+    int64_t mtime;
+    uint64_t size, hash;
+    uint64_t defs, fields, lists, meta, strings;
+};
+
+struct CacheDef {
+    CacheStr kind, name, desc, ret, category, version, author, since, deprecated;
+    CacheRange fields, links, examples, notes, tags, meta;
+};
+
+struct CacheField {
+    CacheStr type, name, desc, defval;
+    CacheRange tags;
+    uint32_t required;
+};
+
+struct CacheMeta { CacheStr key, value; };
+
+const char cacheMagic[8] = { 'S', 'D', 'O', 'C', 'B', '\r', '\n', 0 };
+const uint32_t cacheVersion = 2;
+
+int64_t mtimeOf(const struct stat& st) { return st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec; }
+
+string cachePath(const string& cacheDir, const string& path) {
+    char name[40];
+    snprintf(name, sizeof(name), "/%016llx.sdocb", (unsigned long long)fnv1a(filesystem::absolute(path).lexically_normal().string()));
+    return cacheDir + name;
+}
+
+// Errors are ignored; the cache only saves work.
+void storeCache(const Out& f, const string& file) {
+    error_code ec;
+    filesystem::create_directories(filesystem::path(file).parent_path(), ec);
+    try {
+        f.save(file + ".tmp");
+        replaceFile(file + ".tmp", file);
+    } catch (const exception&) {
+        remove((file + ".tmp").c_str());
+    }
+}
+
+void saveCache(const string& file, const vector<Def>& defs, const struct stat& st, uint64_t hash) {
+    Phase phase("cache write");
+    vector<CacheDef> drecs;
+    vector<CacheField> frecs;
+    vector<CacheStr> lists;
+    vector<CacheMeta> meta;
+    string strings;
+    auto str = [&](string_view v) -> CacheStr {
+        strings.append(v.data(), v.size());
+        return { (uint32_t)(strings.size() - v.size()), (uint32_t)v.size() };
+    };
+    auto list = [&](Span<string_view> v) -> CacheRange {
+        CacheRange r = { (uint32_t)lists.size(), (uint32_t)v.size() };
+        for (auto x : v) lists.push_back(str(x));
+        return r;
+    };
+    for (const auto& d : defs) {
+        CacheDef r = { str(d.kind), str(d.name), str(d.desc), str(d.ret), str(d.category), str(d.version), str(d.author), str(d.since),
+                       str(d.deprecated), {}, list(d.links), list(d.examples), list(d.notes), list(d.tags), {} };
+        r.fields = { (uint32_t)frecs.size(), (uint32_t)d.fields.size() };
+        for (const auto& f : d.fields) frecs.push_back({ str(f.type), str(f.name), str(f.desc), str(f.defval), list(f.tags), f.required });
+        r.meta = { (uint32_t)meta.size(), (uint32_t)d.meta.size() };
+        for (const auto& m : d.meta) meta.push_back({ str(m.first), str(m.second) });
+        drecs.push_back(r);
+    }
+    
+    if (strings.size() > UINT32_MAX) return;
+    
+    CacheHeader h = {};
+    memcpy(h.magic, cacheMagic, sizeof h.magic);
+    h.version = cacheVersion;
+    h.mtime = mtimeOf(st);
+    h.size = st.st_size;
+    h.hash = hash;
+    h.defs = drecs.size();
+    h.fields = frecs.size();
+    h.lists = lists.size();
+    h.meta = meta.size();
+    h.strings = strings.size();
+    Out& f = threadBuffer();
+    f.write(reinterpret_cast<const char*>(&h), sizeof h);
+    f.write(reinterpret_cast<const char*>(drecs.data()), drecs.size() * sizeof(CacheDef));
+    f.write(reinterpret_cast<const char*>(frecs.data()), frecs.size() * sizeof(CacheField));
+    f.write(reinterpret_cast<const char*>(lists.data()), lists.size() * sizeof(CacheStr));
+    f.write(reinterpret_cast<const char*>(meta.data()), meta.size() * sizeof(CacheMeta));
+    f << strings;
+    storeCache(f, file);
+}
+
+// Same size and mtime, or same content hash after a touch.
+bool loadCache(Source& src, const string& file, const struct stat& st) {
+    Phase phase("cache load");
+    if (access(file.c_str(), R_OK) != 0) return false;
+    auto map = make_unique<MappedFile>(file);
+    string_view v = map->view();
+    CacheHeader h;
+    if (v.size() < sizeof h) return false;
+    memcpy(&h, v.data(), sizeof h);
+    if (memcmp(h.magic, cacheMagic, sizeof h.magic) != 0 || h.version != cacheVersion || h.size != (uint64_t)st.st_size) return false;
+    if (h.defs > v.size() || h.fields > v.size() || h.lists > v.size() || h.meta > v.size() || h.strings > v.size()) return false;
+    if (sizeof h + h.defs * sizeof(CacheDef) + h.fields * sizeof(CacheField) + h.lists * sizeof(CacheStr) +
+        h.meta * sizeof(CacheMeta) + h.strings != v.size()) return false;
+    if (h.mtime != mtimeOf(st)) {
+        if (fnv1a(MappedFile(src.path).view()) != h.hash) return false;
+        h.mtime = mtimeOf(st);
+        Out& f = threadBuffer();
+        f.write(reinterpret_cast<const char*>(&h), sizeof h);
+        f << v.substr(sizeof h);
+        storeCache(f, file);
+    }
+    
+    const char* at = v.data() + sizeof h;
+    auto defs = reinterpret_cast<const CacheDef*>(at);
+    auto frecs = reinterpret_cast<const CacheField*>(at += h.defs * sizeof(CacheDef));
+    auto lrecs = reinterpret_cast<const CacheStr*>(at += h.fields * sizeof(CacheField));
+    auto mrecs = reinterpret_cast<const CacheMeta*>(at += h.lists * sizeof(CacheStr));
+    const char* strings = at + h.meta * sizeof(CacheMeta);
+    
+    bool ok = true;
+    auto str = [&](CacheStr s) {
+        if ((uint64_t)s.off + s.len > h.strings) { ok = false; return string_view(); }
+        return string_view(strings + s.off, s.len);
+    };
+    auto range = [&](CacheRange r, uint64_t n) {
+        if ((uint64_t)r.first + r.count > n) { ok = false; return CacheRange{ 0, 0 }; }
+        return r;
+    };
+    Arena& arena = src.arena;
+    auto fields = static_cast<Field*>(arena.allocate(max<uint64_t>(h.fields, 1) * sizeof(Field), alignof(Field)));
+    auto lists = static_cast<string_view*>(arena.allocate(max<uint64_t>(h.lists, 1) * sizeof(string_view), alignof(string_view)));
+    auto meta = static_cast<pair<string_view, string_view>*>(arena.allocate(max<uint64_t>(h.meta, 1) * sizeof(pair<string_view, string_view>),
+                                                                            alignof(pair<string_view, string_view>)));
+    for (uint64_t i = 0; i < h.lists; i++) new (&lists[i]) string_view(str(lrecs[i]));
+    for (uint64_t i = 0; i < h.meta; i++) new (&meta[i]) pair<string_view, string_view>(str(mrecs[i].key), str(mrecs[i].value));
+    auto list = [&](CacheRange r) { r = range(r, h.lists); return Span<string_view>{ lists + r.first, r.count }; };
+    for (uint64_t i = 0; i < h.fields; i++) {
+        const CacheField& r = frecs[i];
+        Field* f = new (&fields[i]) Field();
+        f->type = str(r.type);
+        f->name = str(r.name);
+        f->desc = str(r.desc);
+        f->defval = str(r.defval);
+        f->tags = list(r.tags);
+        f->required = r.required != 0;
+    }
+    src.defs.resize(h.defs);
+    for (uint64_t i = 0; i < h.defs; i++) {
+        const CacheDef& r = defs[i];
+        Def& d = src.defs[i];
+        d.kind = str(r.kind);
+        d.name = str(r.name);
+        d.desc = str(r.desc);
+        d.ret = str(r.ret);
+        d.category = str(r.category);
+        d.version = str(r.version);
+        d.author = str(r.author);
+        d.since = str(r.since);
+        d.deprecated = str(r.deprecated);
+        CacheRange fr = range(r.fields, h.fields), mr = range(r.meta, h.meta);
+        d.fields = { fields + fr.first, fr.count };
+        d.meta = { meta + mr.first, mr.count };
+        d.links = list(r.links);
+        d.examples = list(r.examples);
+        d.notes = list(r.notes);
+        d.tags = list(r.tags);
+    }
+    if (!ok) {
+        src.defs.clear();
+        return false;
+    }
+    src.file = move(map);
+    return true;
+}
+
+unique_ptr<Source> parseSource(const string& path, const string& cacheDir = "") {
+    auto src = make_unique<Source>();
+    src->path = path;
+    struct stat st;
+    string cache = cacheDir.empty() || stat(path.c_str(), &st) != 0 ? "" : cachePath(cacheDir, path);
+    if (!cache.empty() && loadCache(*src, cache, st)) return src;
+    src->file = make_unique<MappedFile>(path);
+    try {
+        Phase phase("parse");
+        if (isHeader(path)) {
+            HeaderScanner h(src->file->view(), src->arena);
+            src->defs = h.scan();
+        } else {
+            Parser p(src->file->view(), src->arena);
+            src->defs = p.parse();
+            if (Stats::on) Stats::lane().tokens += p.tokens();
+        }
+    } catch (const exception& e) {
+        throw runtime_error(path + ": " + e.what());
+    }
+    if (!cache.empty()) saveCache(cache, src->defs, st, fnv1a(src->file->view()));
+    return src;
+}
+
+void warnUnresolvedLinks(const Def& d, const string& path) {
+    for (size_t i = 0; i < d.links.size(); i++) {
+        string_view l = d.links[i];
+        if (d.linkRefs[i] >= 0 || find_if(l.begin(), l.end(), [](unsigned char c) { return isspace(c); }) != l.end()) continue;
+        cerr << "Warning: unresolved link '" << l << "' in '" << d.name << "' (" << path << ")\n";
+    }
+}
+
+// Later duplicates are dropped; stale sources are re-resolved against the merged table.
+void linkCorpus(Corpus& c, ThreadPool& pool, vector<bool> stale) {
+    Phase phase("link");
+    size_t total = 0;
+    for (const auto& src : c.sources) total += src->defs.size();
+    c.symbols = SymbolTable(total);
+    vector<pair<size_t, size_t>> kept;
+    Hasher names;
+    for (size_t i = 0; i < c.sources.size(); i++) {
+        const Source& src = *c.sources[i];
+        for (size_t k = 0; k < src.defs.size(); k++) {
+            string_view name = src.defs[k].name;
+            int32_t id = c.symbols.insert(name, (int32_t)kept.size());
+            if (id != (int32_t)kept.size()) {
+                if (stale[i]) {
+                    cerr << "Warning: duplicate definition '" << name << "' in " << src.path
+                         << " (first defined in " << c.sources[kept[id].first]->path << "), ignoring it\n";
+                }
+                continue;
+            }
+            kept.push_back({ i, k });
+            names.add(name);
+        }
+    }
+    if (names.h != c.names) stale.assign(stale.size(), true);
+    c.names = names.h;
+    
+    pool.run(c.sources.size(), [&](size_t i) {
+        if (!stale[i]) return;
+        Phase phase("resolve");
+        Source& src = *c.sources[i];
+        auto old = move(src.refs);
+        src.refs = make_unique<Arena>();
+        Resolver r(c.symbols, *src.refs);
+        src.hashes.clear();
+        src.cards.clear();
+        for (auto& d : src.defs) {
+            r.resolve(d);
+            src.hashes.push_back(hashDef(d));
+            src.cards.push_back(hashCard(d));
+        }
+    });
+    
+    c.defs.clear();
+    c.origin.clear();
+    c.hashes.clear();
+    c.cards.clear();
+    c.stale.clear();
+    c.entries.clear();
+    c.usedBy = UsageGraph();
+    for (const auto& k : kept) {
+        const Source* src = c.sources[k.first].get();
+        const Def& d = src->defs[k.second];
+        c.usedBy.add((uint32_t)c.defs.size(), d);
+        c.entries.push_back({ d.kind, d.name, d.category, (uint32_t)k.first });
+        c.defs.push_back(d);
+        c.origin.push_back(src);
+        c.hashes.push_back(src->hashes[k.second]);
+        c.cards.push_back(src->cards[k.second]);
+        c.stale.push_back(stale[k.first]);
+        if (stale[k.first]) warnUnresolvedLinks(d, src->path);
+    }
+    c.usedBy.finish(c.defs.size());
+}
+
+Corpus loadCorpus(const vector<string>& paths, ThreadPool& pool, const string& cacheDir = "") {
+    Phase phase("load");
+    Corpus c;
+    c.sources.resize(paths.size());
+    pool.run(paths.size(), [&](size_t i) { c.sources[i] = parseSource(paths[i], cacheDir); });
+    linkCorpus(c, pool, vector<bool>(paths.size(), true));
+    return c;
+}
+
+struct Options {
+    bool sharedNav = false, sharedCss = false, force = false, watch = false, stream = false, stats = false;
+    bool minify = false, gzip = false, archive = false, pageDirs = false, headers = false;
+    string stylesheet, trace, format = "html", cacheDir;
+    size_t jobs = 1, shardSize = 0;
+};
+
+void makePageDirs(const string& outdir, const vector<string_view>& names) {
+    bool made[256] = {};
+    for (auto name : names) {
+        unsigned k = pageDir(name);
+        if (made[k]) continue;
+        made[k] = true;
+        char d[4];
+        snprintf(d, sizeof d, "/%02x", k);
+        mkdir((outdir + d).c_str(), 0755);
+    }
+}
+
+void removeOtherLayouts(const string& outdir, const Manifest& manifest, const Options& opt) {
+    for (const auto& p : manifest.pages) {
+        for (bool dirs : { false, true }) {
+            if (!opt.archive && dirs == opt.pageDirs) continue;
+            string file = outdir + "/" + pagePath(p.first, dirs);
+            remove(file.c_str());
+            remove((file + ".gz").c_str());
+        }
+    }
+}
+
+// Rewrites the pages whose content or referenced names changed since manifest.
+size_t build(const Corpus& corpus, const Options& opt, const Style& style, const string& outdir, Manifest& manifest, ThreadPool& pool) {
+    Phase phase("build");
+    filesystem::create_directories(outdir);
+    const vector<Def>& defs = corpus.defs;
+    Sidebar nav = buildSidebar(defs, opt.sharedNav);
+    
+    uint64_t config = Hasher().add(opt.sharedNav).add(opt.shardSize).add(style.css).add(style.href).add(opt.minify).add(opt.gzip)
+        .add(opt.archive).add(opt.pageDirs).h;
+    uint64_t navHash = fnv1a(nav.html);
+    bool all = opt.archive || manifest.config != config || (!nav.shared && manifest.nav != navHash);
+    
+    // A page lists its users, so a stale user old or new makes it stale too.
+    vector<bool> check = corpus.stale;
+    for (size_t j = 0; !all && j < defs.size(); j++) {
+        if (!corpus.stale[j]) continue;
+        forEachRef(defs[j], [&](int32_t to, uint8_t) { check[to] = true; });
+        auto old = manifest.pages.find(defs[j].name);
+        if (old == manifest.pages.end()) continue;
+        for (const auto& r : old->second.refs) {
+            int32_t id = corpus.symbols.find(r);
+            if (id >= 0) check[id] = true;
+        }
+    }
+    
+    Hasher index;
+    vector<size_t> dirty, changed;
+    vector<Manifest::Page> pages;
+    for (size_t i = 0; i < defs.size(); i++) {
+        const Def& d = defs[i];
+        index.add(corpus.cards[i]);
+        if (!all && !check[i]) continue;
+        uint64_t h = Hasher().add(corpus.hashes[i]).add(hashUsers(corpus.users(i))).h;
+        Manifest::Page page;
+        page.hash = h;
+        for (auto r : pageRefs(d)) page.refs.emplace_back(r);
+        
+        auto old = manifest.pages.find(d.name);
+        bool stale = all || old == manifest.pages.end() || old->second.hash != h ||
+            access((outdir + "/" + pagePath(d.name)).c_str(), F_OK) != 0;
+        for (size_t k = 0; !stale && k < page.refs.size(); k++) {
+            stale = (manifest.pages.count(page.refs[k]) != 0) != (corpus.symbols.find(page.refs[k]) >= 0);
+        }
+        if (stale) dirty.push_back(i);
+        if (old == manifest.pages.end() || old->second.hash != h || old->second.refs != page.refs) {
+            changed.push_back(i);
+            pages.push_back(move(page));
+        }
+    }
+    bool indexStale = all || manifest.index != index.h || access((outdir + "/index.html").c_str(), F_OK) != 0 ||
+        access((outdir + "/search-index.js").c_str(), F_OK) != 0;
+    
+    if (manifest.config != config) {
+        if (!opt.gzip) removeCompressed(outdir);
+        removeOtherLayouts(outdir, manifest, opt);
+    }
+    unique_ptr<Archive> archive;
+    if (opt.archive) archive = make_unique<Archive>(outdir);
+    if (!style.href.empty()) writeStyle(style, outdir);
+    if (nav.shared && (archive || manifest.nav != navHash || access((outdir + "/nav.js").c_str(), F_OK) != 0)) generateNav(nav, outdir);
+    for (size_t k = 0; k < changed.size(); k++) manifest.pages[string(defs[changed[k]].name)] = move(pages[k]);
+    for (auto it = manifest.pages.begin(); manifest.pages.size() > defs.size() && it != manifest.pages.end(); ) {
+        if (corpus.symbols.find(it->first) >= 0) { ++it; continue; }
+        if (!archive) {
+            string file = outdir + "/" + pagePath(it->first);
+            remove(file.c_str());
+            if (opt.gzip) remove((file + ".gz").c_str());
+        }
+        it = manifest.pages.erase(it);
+    }
+    
+    if (opt.pageDirs && !archive) {
+        vector<string_view> names;
+        for (size_t i : dirty) names.push_back(defs[i].name);
+        makePageDirs(outdir, names);
+    }
+    pool.run(dirty.size() + indexStale, [&](size_t i) {
+        if (i == dirty.size() && opt.shardSize) generateShardedIndex(defs, outdir, style, opt.shardSize);
+        else if (i == dirty.size()) { generateIndex(defs, outdir, style); generateSearchIndex(defs, outdir); }
+        else generatePage(defs[dirty[i]], outdir, nav, style, corpus.users(dirty[i]));
+    });
+    if (archive) archive->finish();
+    
+    manifest.config = config;
+    manifest.nav = navHash;
+    manifest.index = index.h;
+    manifest.save(outdir);
+    return dirty.size() + indexStale;
+}
+
+// Directories are watched, since editors often save by renaming over the file.
+void watchInputs(const vector<string>& args, Corpus& corpus, const Options& opt, const Style& style, const string& outdir,
+                 Manifest& manifest, ThreadPool& pool) {
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0) throw runtime_error(string("Cannot watch inputs: ") + strerror(errno));
+    map<int, string> dirs;
+    auto watchDir = [&](const filesystem::path& dir) {
+        string d = dir.empty() ? "." : dir.lexically_normal().string();
+        int wd = inotify_add_watch(fd, d.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE);
+        if (wd >= 0) dirs[wd] = d;
+    };
+    auto watchArgs = [&]() {
+        for (const auto& a : args) {
+            if (!filesystem::is_directory(a)) continue;
+            watchDir(a);
+            for (const auto& e : filesystem::recursive_directory_iterator(a)) if (e.is_directory()) watchDir(e.path());
+        }
+    };
+    watchArgs();
+    for (const auto& src : corpus.sources) watchDir(filesystem::path(src->path).parent_path());
+    cout << "Watching " << corpus.sources.size() << " input files for changes (Ctrl-C to stop)\n";
+    
+    alignas(inotify_event) char buf[64 * 1024];
+    for (;;) {
+        set<string> changed;
+        bool listing = false, rescan = false;
+        pollfd p = { fd, POLLIN, 0 };
+        // One save is usually a burst of events; wait for a short quiet period.
+        for (int timeout = -1; poll(&p, 1, timeout) > 0; timeout = 10) {
+            ssize_t n = read(fd, buf, sizeof buf);
+            for (char* at = buf; n > 0 && at < buf + n; ) {
+                const auto* e = reinterpret_cast<const inotify_event*>(at);
+                // Events were lost or a watched directory went away: check everything.
+                if (e->mask & (IN_Q_OVERFLOW | IN_IGNORED)) {
+                    if (e->mask & IN_IGNORED) dirs.erase(e->wd);
+                    listing = rescan = true;
+                } else if (e->len) {
+                    changed.insert((filesystem::path(dirs[e->wd]) / e->name).lexically_normal().string());
+                    if (e->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM)) listing = true;
+                }
+                at += sizeof(inotify_event) + e->len;
+            }
+        }
+        auto t0 = chrono::steady_clock::now();
+        
+        try {
+            vector<string> paths;
+            if (rescan) watchArgs();
+            if (listing) paths = expandInputs(args, opt.headers);
+            else for (const auto& src : corpus.sources) paths.push_back(src->path);
+            
+            map<string, size_t> known;
+            for (size_t i = 0; i < corpus.sources.size(); i++) known[filesystem::path(corpus.sources[i]->path).lexically_normal().string()] = i;
+            vector<unique_ptr<Source>> sources(paths.size());
+            vector<bool> stale(paths.size());
+            size_t reparsed = 0;
+            for (size_t i = 0; i < paths.size(); i++) {
+                string key = filesystem::path(paths[i]).lexically_normal().string();
+                stale[i] = rescan || !known.count(key) || changed.count(key);
+                reparsed += stale[i];
+            }
+            if (reparsed == 0 && paths.size() == corpus.sources.size()) continue;
+            pool.run(paths.size(), [&](size_t i) { if (stale[i]) sources[i] = parseSource(paths[i], opt.cacheDir); });
+            for (size_t i = 0; i < paths.size(); i++) {
+                if (!stale[i]) sources[i] = move(corpus.sources[known[filesystem::path(paths[i]).lexically_normal().string()]]);
+            }
+            
+            corpus.sources = move(sources);
+            for (const auto& src : corpus.sources) watchDir(filesystem::path(src->path).parent_path());
+            linkCorpus(corpus, pool, stale);
+            size_t rewritten = build(corpus, opt, style, outdir, manifest, pool);
+            printf("Rebuilt %zu of %zu pages from %zu changed files in %.1f ms\n", rewritten, corpus.defs.size() + 1, reparsed,
+                   chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+            fflush(stdout);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << "\n";
+        }
+    }
+}
+
+// All batches share one arena; headers come as a single batch.
+void forEachBatch(const string& path, size_t n, const function<void(vector<Def>&)>& fn) {
+    MappedFile file(path);
+    Arena scratch, vocab;
+    vector<Def> batch;
+    if (isHeader(path)) {
+        try {
+            Phase phase("parse");
+            HeaderScanner h(file.view(), scratch);
+            batch = h.scan();
+        } catch (const exception& e) {
+            throw runtime_error(path + ": " + e.what());
+        }
+        fn(batch);
+        return;
+    }
+    
+    Parser p(file.view(), scratch, vocab);
+    for (bool more = true; more; ) {
+        batch.clear();
+        scratch.reset();
+        Def d;
+        try {
+            Phase phase("parse");
+            while (batch.size() < n && (more = p.next(d))) batch.push_back(d);
+        } catch (const exception& e) {
+            throw runtime_error(path + ": " + e.what());
+        }
+        if (!batch.empty()) fn(batch);
+    }
+    if (Stats::on) Stats::lane().tokens += p.tokens();
+}
+
+// The names a definition may refer to are kept until the symbol table is
+// complete, then resolved into the returned graph.
+UsageGraph collectEntries(const vector<string>& paths, size_t batchSize, Arena& arena, vector<Entry>& entries, SymbolTable& symbols) {
+    struct Ref {
+        string_view name;
+        uint32_t from;
+        uint8_t how;
+    };
+    Interner vocab(arena);
+    vector<Ref> refs;
+    for (uint32_t file = 0; file < paths.size(); file++) {
+        forEachBatch(paths[file], batchSize, [&](vector<Def>& defs) {
+            for (const auto& d : defs) {
+                int32_t id = symbols.find(d.name);
+                if (id >= 0) {
+                    cerr << "Warning: duplicate definition '" << d.name << "' in " << paths[file]
+                         << " (first defined in " << paths[entries[id].file] << "), ignoring it\n";
+                    continue;
+                }
+                uint32_t from = (uint32_t)entries.size();
+                string_view name = arena.copy(d.name);
+                symbols.insert(name, (int32_t)from);
+                entries.push_back({ vocab.intern(d.kind), name, vocab.intern(d.category), file });
+                forEachIdent(d.ret, [&](string_view t) { refs.push_back({ vocab.intern(t), from, USE_RETURN }); });
+                for (const auto& f : d.fields) forEachIdent(f.type, [&](string_view t) { refs.push_back({ vocab.intern(t), from, USE_FIELD }); });
+                for (const auto& l : d.links) refs.push_back({ vocab.intern(l), from, USE_LINK });
+            }
+        });
+    }
+    UsageGraph graph;
+    for (const auto& r : refs) graph.add(r.from, symbols.find(r.name), r.how);
+    graph.finish(entries.size());
+    return graph;
+}
+
+// For inputs too large to keep parsed: entries and usage, then pages batch by batch.
+size_t streamBuild(const vector<string>& paths, const Options& opt, const Style& style, const string& outdir, ThreadPool& pool) {
+    size_t batchSize = 64 * pool.size();
+    Arena arena;
+    vector<Entry> entries;
+    SymbolTable symbols;
+    UsageGraph usedBy = collectEntries(paths, batchSize, arena, entries, symbols);
+    if (entries.empty()) return 0;
+    
+    Phase phase("build");
+    filesystem::create_directories(outdir);
+    remove((outdir + Manifest::file).c_str());
+    if (!opt.gzip) removeCompressed(outdir);
+    unique_ptr<Archive> archive;
+    if (opt.archive) archive = make_unique<Archive>(outdir);
+    Sidebar nav = buildSidebar(entries, opt.sharedNav);
+    if (!style.href.empty()) writeStyle(style, outdir);
+    if (nav.shared) generateNav(nav, outdir);
+    
+    string indexPath = outdir + "/index.html", dataDir = outdir + "/index-data";
+    string indexFile = archive ? outdir + "/.index.html.tmp" : indexPath;
+    Out cards;
+    Gzip gzip;
+    string indexGz;
+    int fd = -1;
+    auto flushIndex = [&](bool last) {
+        if (opt.minify) cards.minify();
+        if (opt.gzip) gzip.add(cards.str(), indexGz, last);
+        cards.flush(fd, indexFile);
+    };
+    if (opt.shardSize) {
+        filesystem::create_directories(dataDir);
+    } else {
+        fd = open(indexFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw runtime_error("Cannot write output file '" + indexFile + "'");
+        indexHeader(cards, entries, style);
+        cards << "<div class=\"grid\" id=\"items\">\n";
+    }
+    
+    SearchIndex search;
+    Arena refs;
+    vector<Def> kept;
+    uint32_t next = 0;
+    try {
+        for (uint32_t file = 0; file < paths.size(); file++) {
+            forEachBatch(paths[file], batchSize, [&](vector<Def>& defs) {
+                kept.clear();
+                for (const auto& d : defs) {
+                    if (symbols.find(d.name) == (int32_t)(next + kept.size())) kept.push_back(d);
+                }
+                refs.reset();
+                Resolver r(symbols, refs);
+                for (auto& d : kept) r.resolve(d);
+                if (opt.pageDirs && !archive) {
+                    vector<string_view> names;
+                    for (const auto& d : kept) names.push_back(d.name);
+                    makePageDirs(outdir, names);
+                }
+                pool.run(kept.size(), [&](size_t i) { generatePage(kept[i], outdir, nav, style, { usedBy[next + i], entries.data() }); });
+                for (const auto& d : kept) {
+                    warnUnresolvedLinks(d, paths[file]);
+                    search.add(next++, d);
+                    indexCard(cards, d);
+                    if (opt.shardSize && next % opt.shardSize == 0) {
+                        saveShard(dataDir, next / opt.shardSize - 1, cards);
+                        cards.clear();
+                    }
+                }
+                // Cards end in a block tag, so each chunk minifies on its own.
+                if (fd >= 0 && cards.size() >= (1 << 20)) flushIndex(false);
+            });
+        }
+        if (fd >= 0) {
+            indexTail(cards);
+            flushIndex(true);
+            close(fd);
+            fd = -1;
+            if (archive) {
+                Out::store(indexPath, MappedFile(indexFile).view());
+                remove(indexFile.c_str());
+            }
+            if (opt.gzip) Out::store(indexPath + ".gz", indexGz);
+        }
+    } catch (...) {
+        if (fd >= 0) close(fd);
+        throw;
+    }
+    
+    if (opt.shardSize) {
+        size_t shards = (entries.size() + opt.shardSize - 1) / opt.shardSize;
+        if (cards.size()) saveShard(dataDir, shards - 1, cards);
+        removeShards(dataDir, shards);
+        Out& f = threadBuffer();
+        shardedIndexPage(f, entries, style, opt.shardSize);
+        f.publish(indexPath);
+    }
+    search.save(outdir);
+    if (archive) archive->finish();
+    return entries.size();
+}
+
+// NDJSON or one array, written in order from per-thread buffers.
+class JsonExport {
+    string path;
+    int fd = 1;
+    bool array;
+    size_t count = 0;
+    vector<Out> parts;
+    
+public:
+    JsonExport(const string& file, bool asArray, size_t threads) : path(file), array(asArray), parts(threads) {
+        if (path == "-") return;
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw runtime_error("Cannot write output file '" + path + "'");
+    }
+    
+    ~JsonExport() { if (fd > 2) close(fd); }
+    
+    JsonExport(const JsonExport&) = delete;
+    JsonExport& operator=(const JsonExport&) = delete;
+    
+    void add(const vector<Def>& defs, const function<string_view(size_t)>& file, ThreadPool& pool) {
+        size_t n = parts.size(), window = 256 * n;
+        for (size_t at = 0; at < defs.size(); at += window) {
+            size_t len = min(window, defs.size() - at);
+            pool.run(n, [&](size_t t) {
+                Phase phase("export");
+                Out& f = parts[t];
+                for (size_t i = at + len * t / n, end = at + len * (t + 1) / n; i < end; i++) {
+                    if (array) f << (count + i ? ",\n" : "[\n");
+                    renderJson(f, defs[i], file(i));
+                    if (!array) f << '\n';
+                }
+            });
+            for (auto& f : parts) f.flush(fd, path);
+        }
+        count += defs.size();
+    }
+    
+    void finish() {
+        Out& f = parts[0];
+        if (array) f << (count ? "\n]\n" : "[]\n");
+        f.flush(fd, path);
+        if (fd > 2 && close(fd) != 0) { fd = -1; throw runtime_error("Cannot write output file '" + path + "'"); }
+        fd = -1;
+    }
+};
+
+size_t exportCorpus(const Corpus& corpus, const string& path, bool array, ThreadPool& pool) {
+    if (corpus.defs.empty()) return 0;
+    Phase phase("build");
+    JsonExport out(path, array, pool.size());
+    out.add(corpus.defs, [&](size_t i) { return string_view(corpus.origin[i]->path); }, pool);
+    out.finish();
+    return corpus.defs.size();
+}
+
+size_t streamExport(const vector<string>& paths, const string& path, bool array, ThreadPool& pool) {
+    size_t batchSize = 64 * pool.size();
+    Arena arena;
+    vector<Entry> entries;
+    SymbolTable symbols;
+    collectEntries(paths, batchSize, arena, entries, symbols);
+    if (entries.empty()) return 0;
+    
+    Phase phase("build");
+    JsonExport out(path, array, pool.size());
+    Arena refs;
+    vector<Def> kept;
+    uint32_t next = 0;
+    for (uint32_t file = 0; file < paths.size(); file++) {
+        forEachBatch(paths[file], batchSize, [&](vector<Def>& defs) {
+            kept.clear();
+            for (const auto& d : defs) {
+                if (symbols.find(d.name) == (int32_t)(next + kept.size())) kept.push_back(d);
+            }
+            refs.reset();
+            Resolver r(symbols, refs);
+            for (auto& d : kept) r.resolve(d);
+            out.add(kept, [&](size_t) { return string_view(paths[file]); }, pool);
+            for (const auto& d : kept) warnUnresolvedLinks(d, paths[file]);
+            next += kept.size();
+        });
+    }
+    out.finish();
+    return entries.size();
+}
+
+// 1.10 follows 1.9; missing parts count as 0.
+int compareVersions(string_view a, string_view b) {
+    auto part = [](string_view s, size_t& at) {
+        if (at >= s.size()) return string_view("0");
+        size_t end = min(s.find('.', at), s.size());
+        string_view p = s.substr(at, end - at);
+        at = end + 1;
+        return p;
+    };
+    auto numeric = [](string_view p) {
+        return !p.empty() && all_of(p.begin(), p.end(), [](char c) { return c >= '0' && c <= '9'; });
+    };
+    for (size_t i = 0, j = 0; i < a.size() || j < b.size(); ) {
+        string_view x = part(a, i), y = part(b, j);
+        int c;
+        if (numeric(x) && numeric(y)) {
+            x.remove_prefix(min(x.find_first_not_of('0'), x.size()));
+            y.remove_prefix(min(y.find_first_not_of('0'), y.size()));
+            c = x.size() != y.size() ? (x.size() < y.size() ? -1 : 1) : x.compare(y);
+        } else {
+            c = x.compare(y);
+        }
+        if (c != 0) return c < 0 ? -1 : 1;
+    }
+    return 0;
+}
+
+class QueryIndex {
+    const Corpus& corpus;
+    vector<uint32_t> byName, bySince;
+    unordered_map<string_view, vector<uint32_t>> tags, categories, kinds;
+    vector<uint32_t> hits, term, both;
+    
+    static void post(unordered_map<string_view, vector<uint32_t>>& m, string_view key, uint32_t id) {
+        auto& ids = m[key];
+        if (ids.empty() || ids.back() != id) ids.push_back(id);
+    }
+    
+    static void postings(const unordered_map<string_view, vector<uint32_t>>& m, string_view key, vector<uint32_t>& ids) {
+        auto it = m.find(key);
+        if (it != m.end()) ids = it->second;
+    }
+    
+    bool lookup(string_view key, string_view value, vector<uint32_t>& ids) const {
+        const vector<Def>& defs = corpus.defs;
+        ids.clear();
+        if (key == "name") {
+            int32_t id = corpus.symbols.find(value);
+            if (id >= 0) ids.push_back(id);
+        } else if (key == "prefix") {
+            auto it = lower_bound(byName.begin(), byName.end(), value, [&](uint32_t i, string_view v) { return defs[i].name < v; });
+            for (; it != byName.end() && defs[*it].name.substr(0, value.size()) == value; ++it) ids.push_back(*it);
+            sort(ids.begin(), ids.end());
+        } else if (key == "since") {
+            auto it = lower_bound(bySince.begin(), bySince.end(), value,
+                                  [&](uint32_t i, string_view v) { return compareVersions(defs[i].since, v) < 0; });
+            ids.assign(it, bySince.end());
+            sort(ids.begin(), ids.end());
+        } else if (key == "tag") {
+            postings(tags, value, ids);
+        } else if (key == "category") {
+            postings(categories, value, ids);
+        } else if (key == "kind") {
+            postings(kinds, value, ids);
+        } else {
+            return false;
+        }
+        return true;
+    }
+    
+public:
+    explicit QueryIndex(const Corpus& c) : corpus(c) {
+        Phase phase("query index");
+        const vector<Def>& defs = c.defs;
+        for (uint32_t i = 0; i < defs.size(); i++) {
+            const Def& d = defs[i];
+            byName.push_back(i);
+            if (!d.since.empty()) bySince.push_back(i);
+            for (auto t : d.tags) post(tags, t, i);
+            if (!d.category.empty()) post(categories, d.category, i);
+            post(kinds, d.kind, i);
+        }
+        sort(byName.begin(), byName.end(), [&](uint32_t a, uint32_t b) { return defs[a].name < defs[b].name; });
+        stable_sort(bySince.begin(), bySince.end(), [&](uint32_t a, uint32_t b) { return compareVersions(defs[a].since, defs[b].since) < 0; });
+    }
+    
+    // "key value" terms (name, prefix, tag, category, kind, since) and "limit N"; a blank line ends the answer.
+    void answer(string_view q, Out& out) {
+        vector<string_view> words;
+        for (size_t i = 0; i < q.size(); ) {
+            if (isspace((unsigned char)q[i])) { i++; continue; }
+            size_t start = i;
+            if (q[i] == '"') {
+                size_t end = q.find('"', ++start);
+                if (end == string_view::npos) end = q.size();
+                words.push_back(q.substr(start, end - start));
+                i = end + 1;
+                continue;
+            }
+            while (i < q.size() && !isspace((unsigned char)q[i])) i++;
+            words.push_back(q.substr(start, i - start));
+        }
+        if (words.size() == 1) words.insert(words.begin(), "name");
+        
+        auto error = [&](const string& msg) { out << "{\"error\":" << json(msg) << "}\n\n"; };
+        if (words.size() % 2 != 0) return error("expected key value pairs");
+        size_t limit = SIZE_MAX;
+        bool first = true;
+        hits.clear();
+        for (size_t k = 0; k < words.size(); k += 2) {
+            if (words[k] == "limit") {
+                string_view n = words[k + 1];
+                if (n.empty() || from_chars(n.data(), n.data() + n.size(), limit).ptr != n.data() + n.size()) return error("limit expects a number");
+                continue;
+            }
+            if (!lookup(words[k], words[k + 1], term)) return error("unknown key '" + string(words[k]) + "'");
+            if (first) {
+                hits.swap(term);
+                first = false;
+            } else {
+                both.clear();
+                set_intersection(hits.begin(), hits.end(), term.begin(), term.end(), back_inserter(both));
+                hits.swap(both);
+            }
+        }
+        for (size_t i = 0; i < hits.size() && i < limit; i++) {
+            renderJson(out, corpus.defs[hits[i]], corpus.origin[hits[i]]->path);
+            out << '\n';
+        }
+        out << '\n';
+    }
+};
+
+class PageCache {
+    struct Item {
+        string path;
+        shared_ptr<const string> body;
+    };
+    
+    list<Item> order;
+    unordered_map<string_view, list<Item>::iterator> items;
+    size_t bytes = 0, limit;
+    mutex m;
+    
+public:
+    explicit PageCache(size_t maxBytes) : limit(maxBytes) {}
+    
+    shared_ptr<const string> find(string_view path) {
+        lock_guard<mutex> l(m);
+        auto it = items.find(path);
+        if (it == items.end()) return nullptr;
+        order.splice(order.begin(), order, it->second);
+        return it->second->body;
+    }
+    
+    void add(string_view path, shared_ptr<const string> body) {
+        lock_guard<mutex> l(m);
+        if (body->size() > limit || items.count(path)) return;
+        order.push_front({ string(path), body });
+        items.emplace(order.front().path, order.begin());
+        bytes += body->size();
+        while (bytes > limit) {
+            bytes -= order.back().body->size();
+            items.erase(order.back().path);
+            order.pop_back();
+        }
+    }
+};
+
+class Server {
+    const Corpus& corpus;
+    const Sidebar& nav;
+    const Style& style;
+    PageCache cache;
+    uint64_t config, cards;
+    int listener = -1;
+    mutex m;
+    condition_variable wake;
+    deque<int> pending;
+    vector<thread> workers;
+    
+    static constexpr int keepAliveMs = 5000, idleCheckMs = 50;
+    static constexpr size_t maxHeader = 64 * 1024;
+    
+    struct Resource {
+        string_view type;
+        uint64_t tag = 0;
+        function<void(Out&)> render;
+    };
+    
+    bool resource(string_view path, Resource& r) const {
+        if (path == "/index.html") {
+            r = { "text/html; charset=utf-8", Hasher().add(config).add(cards).h, [this](Out& f) { renderIndex(f, corpus.defs, style); } };
+        } else if (path == "/search-index.js") {
+            r = { "text/javascript; charset=utf-8", cards, [this](Out& f) { renderSearchIndex(f, corpus.defs); } };
+        } else if (nav.shared && path == "/nav.js") {
+            r = { "text/javascript; charset=utf-8", fnv1a(nav.html), [this](Out& f) { renderNav(f, nav); } };
+        } else if (!style.href.empty() && path.substr(1) == style.href) {
+            r = { "text/css; charset=utf-8", fnv1a(style.css), [this](Out& f) { f << style.css; } };
+        } else if (path.size() > 6 && path.substr(path.size() - 5) == ".html") {
+            int32_t id = corpus.symbols.find(path.substr(1, path.size() - 6));
+            if (id < 0) return false;
+            UsedBy used = corpus.users(id);
+            r = { "text/html; charset=utf-8", Hasher().add(config).add(corpus.hashes[id]).add(hashUsers(used)).h,
+                  [this, id, used](Out& f) { renderPage(f, corpus.defs[id], nav, style, used); } };
+        } else {
+            return false;
+        }
+        return true;
+    }
+    
+    static bool sendAll(int fd, string_view head, string_view body) {
+        iovec v[2] = { { (void*)head.data(), head.size() }, { (void*)body.data(), body.size() } };
+        int n = body.empty() ? 1 : 2;
+        iovec* at = v;
+        while (n > 0) {
+            ssize_t w = writev(fd, at, n);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) return false;
+            size_t k = w;
+            for (; n > 0 && k >= at->iov_len; n--) k -= at++->iov_len;
+            if (n > 0) {
+                at->iov_base = (char*)at->iov_base + k;
+                at->iov_len -= k;
+            }
+        }
+        return true;
+    }
+    
+    static string_view header(string_view head, string_view name) {
+        for (size_t at = head.find("\r\n"); at != string_view::npos; ) {
+            size_t start = at + 2, end = min(head.find("\r\n", start), head.size());
+            string_view line = head.substr(start, end - start);
+            at = end < head.size() ? end : string_view::npos;
+            if (line.size() <= name.size() || line[name.size()] != ':') continue;
+            bool same = equal(name.begin(), name.end(), line.begin(), [](unsigned char a, unsigned char b) { return tolower(a) == tolower(b); });
+            if (!same) continue;
+            string_view v = line.substr(name.size() + 1);
+            while (!v.empty() && (v.front() == ' ' || v.front() == '\t')) v.remove_prefix(1);
+            return v;
+        }
+        return {};
+    }
+    
+    static int hexDigit(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+    
+    static string decode(string_view target) {
+        target = target.substr(0, target.find('?'));
+        string path;
+        for (size_t i = 0; i < target.size(); i++) {
+            int hi, lo;
+            if (target[i] == '%' && i + 2 < target.size() && (hi = hexDigit(target[i + 1])) >= 0 && (lo = hexDigit(target[i + 2])) >= 0) {
+                path += char(hi << 4 | lo);
+                i += 2;
+            } else {
+                path += target[i];
+            }
+        }
+        if (path == "/") path = "/index.html";
+        return path;
+    }
+    
+    bool respond(int fd, string_view head) {
+        size_t sp1 = head.find(' '), sp2 = head.find(' ', sp1 + 1), eol = min(head.find("\r\n"), head.size());
+        if (sp1 == string_view::npos || sp2 == string_view::npos || sp2 > eol) {
+            sendAll(fd, "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", {});
+            return false;
+        }
+        string_view method = head.substr(0, sp1), target = head.substr(sp1 + 1, sp2 - sp1 - 1), version = head.substr(sp2 + 1, eol - sp2 - 1);
+        string_view connection = header(head, "Connection");
+        bool keepAlive = version == "HTTP/1.1" ? connection != "close" : connection == "keep-alive";
+        string_view persist = keepAlive ? "keep-alive" : "close";
+        
+        char line[160];
+        if (method != "GET" && method != "HEAD") {
+            int n = snprintf(line, sizeof line, "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET, HEAD\r\nContent-Length: 0\r\nConnection: %.*s\r\n\r\n",
+                             (int)persist.size(), persist.data());
+            return sendAll(fd, string_view(line, n), {}) && keepAlive;
+        }
+        string path = decode(target);
+        Resource r;
+        if (!resource(path, r)) {
+            static const string_view missing = "Not found\n";
+            int n = snprintf(line, sizeof line, "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\nConnection: %.*s\r\n\r\n",
+                             missing.size(), (int)persist.size(), persist.data());
+            return sendAll(fd, string_view(line, n), method == "HEAD" ? string_view() : missing) && keepAlive;
+        }
+        
+        char etag[20];
+        snprintf(etag, sizeof etag, "\"%016llx\"", (unsigned long long)r.tag);
+        string_view match = header(head, "If-None-Match");
+        if (!match.empty() && (match == "*" || match.find(etag) != string_view::npos)) {
+            int n = snprintf(line, sizeof line, "HTTP/1.1 304 Not Modified\r\nETag: %s\r\nConnection: %.*s\r\n\r\n",
+                             etag, (int)persist.size(), persist.data());
+            return sendAll(fd, string_view(line, n), {}) && keepAlive;
+        }
+        
+        shared_ptr<const string> body = cache.find(path);
+        if (!body) {
+            Out& f = threadBuffer();
+            {
+                Phase phase("render");
+                r.render(f);
+            }
+            f.compact(path);
+            body = make_shared<const string>(f.str());
+            cache.add(path, body);
+        }
+        string head200 = "HTTP/1.1 200 OK\r\nContent-Type: ";
+        head200 += r.type;
+        int n = snprintf(line, sizeof line, "\r\nContent-Length: %zu\r\nETag: %s\r\nCache-Control: no-cache\r\nConnection: %.*s\r\n\r\n",
+                         body->size(), etag, (int)persist.size(), persist.data());
+        head200.append(line, n);
+        return sendAll(fd, head200, method == "HEAD" ? string_view() : string_view(*body)) && keepAlive;
+    }
+    
+    bool queued() {
+        lock_guard<mutex> l(m);
+        return !pending.empty();
+    }
+    
+    // An idle keep-alive connection gives up its worker once another is waiting.
+    bool readable(int fd, bool idle) {
+        pollfd p = { fd, POLLIN, 0 };
+        if (!idle) return poll(&p, 1, keepAliveMs) > 0;
+        for (int waited = 0; waited < keepAliveMs; waited += idleCheckMs) {
+            int r = poll(&p, 1, idleCheckMs);
+            if (r != 0) return r > 0;
+            if (queued()) return false;
+        }
+        return false;
+    }
+    
+    void handle(int fd) {
+        string req;
+        char buf[16384];
+        for (bool served = false;; served = true) {
+            size_t end;
+            while ((end = req.find("\r\n\r\n")) == string::npos) {
+                if (req.size() > maxHeader) return;
+                if (!readable(fd, served && req.empty())) return;
+                ssize_t n = read(fd, buf, sizeof buf);
+                if (n <= 0) return;
+                req.append(buf, n);
+            }
+            // GET and HEAD requests carry no body; the next request follows.
+            if (!respond(fd, string_view(req.data(), end))) return;
+            req.erase(0, end + 4);
+        }
+    }
+    
+    void work() {
+        for (;;) {
+            int fd;
+            {
+                unique_lock<mutex> l(m);
+                wake.wait(l, [&] { return !pending.empty(); });
+                fd = pending.front();
+                pending.pop_front();
+            }
+            handle(fd);
+            close(fd);
+        }
+    }
+    
+public:
+    Server(const Corpus& c, const Sidebar& sidebar, const Style& s, size_t cacheBytes)
+        : corpus(c), nav(sidebar), style(s), cache(cacheBytes) {
+        config = Hasher().add(nav.shared).add(style.css).add(style.href).add(Output::minify).add(nav.html).h;
+        Hasher h;
+        for (auto card : corpus.cards) h.add(card);
+        cards = h.h;
+    }
+    
+    // Loopback only; port 0 picks a free port.
+    uint16_t listen(uint16_t port) {
+        listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+        sockaddr_in a = {};
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        a.sin_port = htons(port);
+        socklen_t len = sizeof a;
+        if (listener < 0 || ::bind(listener, (sockaddr*)&a, sizeof a) != 0 || ::listen(listener, 128) != 0 ||
+            getsockname(listener, (sockaddr*)&a, &len) != 0) {
+            throw runtime_error("Cannot listen on port " + to_string(port) + ": " + strerror(errno));
+        }
+        return ntohs(a.sin_port);
+    }
+    
+    void run(size_t threads) {
+        signal(SIGPIPE, SIG_IGN);
+        for (size_t i = 0; i < threads; i++) workers.emplace_back([this] { work(); });
+        for (;;) {
+            int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                // Out of descriptors or memory: wait for workers to free some.
+                if (errno != EINTR && errno != ECONNABORTED) poll(nullptr, 0, 100);
+                continue;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+            {
+                lock_guard<mutex> l(m);
+                pending.push_back(fd);
+            }
+            wake.notify_one();
+        }
+    }
+};
+
+#ifndef SDOC_NO_MAIN
+constexpr size_t maxJobs = 1024;
+
+bool parseCount(const string& n, size_t limit, size_t& v) {
+    if (n.empty() || n.find_first_not_of("0123456789") != string::npos) return false;
+    errno = 0;
+    unsigned long long x = strtoull(n.c_str(), nullptr, 10);
+    if (errno == ERANGE || x > limit) return false;
+    v = x;
+    return true;
+}
+
+int usage(const char* prog) {
+    cerr << "SDOC - Simple Documentation Generator\n";
+    cerr << "Usage: " << prog << " [options] <input>... <output_dir>\n";
+    cerr << "       " << prog << " --format=json|ndjson [options] <input>... <output_file>|-\n";
+    cerr << "       " << prog << " query [-j N] [--cache=DIR] [-q QUERY]... <input>...\n";
+    cerr << "       " << prog << " serve [--port=N] [--cache-size=MB] [options] <input>...\n";
+    cerr << "Inputs may be files, directories (searched for *.doc) or glob patterns.\n";
+    cerr << "Headers (.h, .hh, .hpp, .hxx) are scanned for Doxygen-style /** */ and /// comments.\n";
+    cerr << "Generates comprehensive HTML documentation from SDOC definition files.\n";
+    cerr << "Options:\n";
+    cerr << "  --nav=inline|shared   Inline the sidebar in every page (default) or load it from nav.js\n";
+    cerr << "  --index-shards=N      Split the index into lazily loaded shards of N cards (0 = single page)\n";
+    cerr << "  --css=inline|shared   Inline the stylesheet in every page (default) or link one style.<hash>.css\n";
+    cerr << "  --stylesheet=FILE     Use FILE instead of the built-in stylesheet\n";
+    cerr << "  --headers             Also scan the C/C++ headers found in input directories\n";
+    cerr << "  -j N                  Parse and render on N threads (0 = one per core, default 1)\n";
+    cerr << "  --watch               Stay running and rebuild affected pages whenever an input changes\n";
+    cerr << "  --cache=DIR           Load unchanged inputs from the AST cache in DIR, and store parsed ones there\n";
+    cerr << "  --force               Rewrite every page instead of only those changed since the last run\n";
+    cerr << "  --stream              Parse the inputs again on each pass, keeping only one batch of definitions in memory\n";
+    cerr << "  --minify              Strip redundant whitespace from the generated HTML and CSS\n";
+    cerr << "  --gzip                Also write a gzip-compressed .gz copy of every generated file\n";
+    cerr << "  --layout=flat|sharded Put pages in the output directory (default) or in 256 hash-named subdirectories\n";
+    cerr << "  --archive             Pack the generated site into site.tar, with an offset index in site.tar.idx\n";
+    cerr << "  --format=FORMAT       Write html pages (default), or all definitions as one json array or as ndjson lines\n";
+    cerr << "  --stats               Print time spent per phase, render time percentiles and I/O counters\n";
+    cerr << "  --trace=FILE          Write a Chrome trace-event JSON file of the build, one lane per thread\n";
+    return 1;
+}
+
+int queryUsage(const char* prog) {
+    cerr << "Usage: " << prog << " query [options] <input>...\n";
+    cerr << "Loads the inputs once and answers each -q QUERY, or else one query per line from stdin.\n";
+    cerr << "A query is one or more terms that must all match:\n";
+    cerr << "  name NAME, prefix TEXT, tag TAG, category NAME, kind KIND, since VERSION (at or after)\n";
+    cerr << "  limit N caps the results; a lone word is a name; quote values with spaces.\n";
+    cerr << "Every match is printed as a line of JSON, and a blank line ends each answer.\n";
+    cerr << "Options:\n";
+    cerr << "  -q QUERY              Answer QUERY and exit instead of reading stdin (repeatable)\n";
+    cerr << "  --cache=DIR           Load unchanged inputs from the AST cache in DIR, and store parsed ones there\n";
+    cerr << "  --headers             Also scan the C/C++ headers found in input directories\n";
+    cerr << "  -j N                  Parse on N threads (0 = one per core, default 1)\n";
+    return 1;
+}
+
+int queryMain(int argc, char** argv, const char* prog) {
+    vector<string> args, queries;
+    string cacheDir;
+    size_t jobs = 1;
+    bool headers = false;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        if (a == "-q" && i + 1 < argc) queries.push_back(argv[++i]);
+        else if (a == "--headers") headers = true;
+        else if (a.compare(0, 8, "--cache=") == 0) cacheDir = a.substr(8);
+        else if (a == "-j" || (a.size() > 2 && a.compare(0, 2, "-j") == 0)) {
+            string n = a.size() > 2 ? a.substr(2) : (i + 1 < argc ? argv[++i] : "");
+            if (!parseCount(n, maxJobs, jobs)) {
+                cerr << "Error: -j expects a thread count of at most " << maxJobs << "\n";
+                return queryUsage(prog);
+            }
+            if (jobs == 0) jobs = max(1u, thread::hardware_concurrency());
+        }
+        else if (a.size() > 1 && a[0] == '-') {
+            cerr << "Error: Unknown option '" << a << "'\n";
+            return queryUsage(prog);
+        }
+        else args.push_back(a);
+    }
+    if (args.empty()) return queryUsage(prog);
+    
+    try {
+        auto t0 = chrono::steady_clock::now();
+        ThreadPool pool(jobs);
+        Corpus corpus = loadCorpus(expandInputs(args, headers), pool, cacheDir);
+        QueryIndex index(corpus);
+        cerr << "Loaded " << corpus.defs.size() << " definitions in "
+             << chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() << " ms\n";
+        
+        // Answers are flushed one by one, so a client can wait for the blank line.
+        Out out;
+        auto answer = [&](string_view q) {
+            index.answer(q, out);
+            out.flush(1, "stdout");
+        };
+        if (!queries.empty()) {
+            for (const auto& q : queries) answer(q);
+        } else {
+            string line;
+            while (getline(cin, line)) answer(line);
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+int serveUsage(const char* prog) {
+    cerr << "Usage: " << prog << " serve [options] <input>...\n";
+    cerr << "Parses the inputs once and serves the documentation on 127.0.0.1, rendering each page when it is first requested.\n";
+    cerr << "Options:\n";
+    cerr << "  --port=N              Listen on port N (default 8080, 0 = any free port)\n";
+    cerr << "  --cache-size=MB       Keep up to MB megabytes of rendered pages in memory (default 64)\n";
+    cerr << "  --cache=DIR           Load unchanged inputs from the AST cache in DIR, and store parsed ones there\n";
+    cerr << "  --nav=inline|shared   Inline the sidebar in every page (default) or load it from nav.js\n";
+    cerr << "  --css=inline|shared   Inline the stylesheet in every page (default) or link one style.<hash>.css\n";
+    cerr << "  --stylesheet=FILE     Use FILE instead of the built-in stylesheet\n";
+    cerr << "  --minify              Strip redundant whitespace from the served HTML and CSS\n";
+    cerr << "  --headers             Also scan the C/C++ headers found in input directories\n";
+    cerr << "  -j N                  Parse and serve on N threads (0 = one per core, the default)\n";
+    return 1;
+}
+
+int serveMain(int argc, char** argv, const char* prog) {
+    vector<string> args;
+    Options opt;
+    opt.jobs = max(1u, thread::hardware_concurrency());
+    string cacheDir;
+    size_t port = 8080, cacheMb = 64;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        if (a == "--nav=inline") opt.sharedNav = false;
+        else if (a == "--nav=shared") opt.sharedNav = true;
+        else if (a == "--css=inline") opt.sharedCss = false;
+        else if (a == "--css=shared") opt.sharedCss = true;
+        else if (a.compare(0, 13, "--stylesheet=") == 0) opt.stylesheet = a.substr(13);
+        else if (a == "--minify") opt.minify = true;
+        else if (a == "--headers") opt.headers = true;
+        else if (a.compare(0, 8, "--cache=") == 0) cacheDir = a.substr(8);
+        else if (a.compare(0, 7, "--port=") == 0) {
+            if (!parseCount(a.substr(7), 65535, port)) {
+                cerr << "Error: --port expects a port number\n";
+                return serveUsage(prog);
+            }
+        }
+        else if (a.compare(0, 13, "--cache-size=") == 0) {
+            if (!parseCount(a.substr(13), 1 << 20, cacheMb)) {
+                cerr << "Error: --cache-size expects a size in megabytes\n";
+                return serveUsage(prog);
+            }
+        }
+        else if (a == "-j" || (a.size() > 2 && a.compare(0, 2, "-j") == 0)) {
+            string n = a.size() > 2 ? a.substr(2) : (i + 1 < argc ? argv[++i] : "");
+            size_t jobs;
+            if (!parseCount(n, maxJobs, jobs)) {
+                cerr << "Error: -j expects a thread count of at most " << maxJobs << "\n";
+                return serveUsage(prog);
+            }
+            if (jobs != 0) opt.jobs = jobs;
+        }
+        else if (a.size() > 1 && a[0] == '-') {
+            cerr << "Error: Unknown option '" << a << "'\n";
+            return serveUsage(prog);
+        }
+        else args.push_back(a);
+    }
+    if (args.empty()) return serveUsage(prog);
+    
+    try {
+        auto t0 = chrono::steady_clock::now();
+        Output::minify = opt.minify;
+        ThreadPool pool(opt.jobs);
+        Style style = loadStyle(opt.stylesheet, opt.sharedCss);
+        Corpus corpus = loadCorpus(expandInputs(args, opt.headers), pool, cacheDir);
+        if (corpus.defs.empty()) {
+            cerr << "Warning: No definitions found in input file\n";
+            return 1;
+        }
+        Sidebar nav = buildSidebar(corpus.defs, opt.sharedNav);
+        Server server(corpus, nav, style, cacheMb << 20);
+        port = server.listen((uint16_t)port);
+        cout << "Serving " << corpus.defs.size() << " definitions at http://127.0.0.1:" << port << "/ (ready in "
+             << chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() << " ms, Ctrl-C to stop)" << endl;
+        server.run(opt.jobs);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && string(argv[1]) == "query") return queryMain(argc - 1, argv + 1, argv[0]);
+    if (argc > 1 && string(argv[1]) == "serve") return serveMain(argc - 1, argv + 1, argv[0]);
+    vector<string> args;
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        if (a == "--nav=inline") opt.sharedNav = false;
+        else if (a == "--nav=shared") opt.sharedNav = true;
+        else if (a == "--css=inline") opt.sharedCss = false;
+        else if (a == "--css=shared") opt.sharedCss = true;
+        else if (a.compare(0, 13, "--stylesheet=") == 0) opt.stylesheet = a.substr(13);
+        else if (a == "--force") opt.force = true;
+        else if (a == "--watch") opt.watch = true;
+        else if (a.compare(0, 8, "--cache=") == 0) opt.cacheDir = a.substr(8);
+        else if (a == "--stream") opt.stream = true;
+        else if (a == "--headers") opt.headers = true;
+        else if (a == "--stats") opt.stats = true;
+        else if (a == "--minify") opt.minify = true;
+        else if (a == "--gzip") opt.gzip = true;
+        else if (a == "--archive") opt.archive = true;
+        else if (a == "--layout=flat") opt.pageDirs = false;
+        else if (a == "--layout=sharded") opt.pageDirs = true;
+        else if (a.compare(0, 8, "--trace=") == 0) opt.trace = a.substr(8);
+        else if (a == "--format=html" || a == "--format=json" || a == "--format=ndjson") opt.format = a.substr(9);
+        else if (a == "-j" || (a.size() > 2 && a.compare(0, 2, "-j") == 0)) {
+            string n = a.size() > 2 ? a.substr(2) : (i + 1 < argc ? argv[++i] : "");
+            if (!parseCount(n, maxJobs, opt.jobs)) {
+                cerr << "Error: -j expects a thread count of at most " << maxJobs << "\n";
+                return usage(argv[0]);
+            }
+            if (opt.jobs == 0) opt.jobs = max(1u, thread::hardware_concurrency());
+        }
+        else if (a.compare(0, 15, "--index-shards=") == 0) {
+            if (!parseCount(a.substr(15), UINT32_MAX, opt.shardSize)) {
+                cerr << "Error: --index-shards expects a card count\n";
+                return usage(argv[0]);
+            }
+        }
+        else if (a.size() > 1 && a[0] == '-') {
+            cerr << "Error: Unknown option '" << a << "'\n";
+            return usage(argv[0]);
+        }
+        else args.push_back(a);
+    }
+    if (args.size() < 2) return usage(argv[0]);
+    if (opt.stream && opt.watch) {
+        cerr << "Error: --stream cannot be combined with --watch\n";
+        return usage(argv[0]);
+    }
+    if (opt.format != "html" && opt.watch) {
+        cerr << "Error: --format=" << opt.format << " cannot be combined with --watch\n";
+        return usage(argv[0]);
+    }
+    
+    string outdir = args.back();
+    args.pop_back();
+    
+    try {
+        if (opt.stats || !opt.trace.empty()) Stats::enable();
+        Output::minify = opt.minify;
+        Output::gzip = opt.gzip;
+        Output::pageDirs = opt.pageDirs;
+        ThreadPool pool(opt.jobs);
+        if (opt.format != "html") {
+            // The export may go to stdout, so the summary goes to stderr.
+            bool array = opt.format == "json";
+            size_t defs = opt.stream ? streamExport(expandInputs(args, opt.headers), outdir, array, pool)
+                                     : exportCorpus(loadCorpus(expandInputs(args, opt.headers), pool, ""), outdir, array, pool);
+            if (defs == 0) {
+                cerr << "Warning: No definitions found in input file\n";
+                return 1;
+            }
+            cerr << "✓ Exported " << defs << " definitions as " << opt.format << " to " << (outdir == "-" ? "stdout" : outdir) << "\n";
+            if (opt.stats) Stats::report(cerr);
+            if (!opt.trace.empty()) Stats::saveTrace(opt.trace);
+            return 0;
+        }
+        Style style = loadStyle(opt.stylesheet, opt.sharedCss);
+        Corpus corpus;
+        Manifest manifest;
+        size_t defs = 0, rewritten = 0;
+        if (opt.stream) {
+            defs = streamBuild(expandInputs(args, opt.headers), opt, style, outdir, pool);
+            rewritten = defs + 1;
+        } else {
+            corpus = loadCorpus(expandInputs(args, opt.headers), pool, opt.cacheDir);
+            defs = corpus.defs.size();
+        }
+        
+        if (defs == 0) {
+            cerr << "Warning: No definitions found in input file\n";
+            return 1;
+        }
+        
+        if (!opt.stream) {
+            if (!opt.force) manifest = Manifest::load(outdir);
+            rewritten = build(corpus, opt, style, outdir, manifest, pool);
+        }
+        
+        cout << "✓ SDOC documentation generated successfully!\n";
+        cout << "  Output directory: " << outdir << "/\n";
+        cout << "  Total pages: " << defs + 1 << " (" << defs << " detail pages + 1 index)\n";
+        if (rewritten < defs + 1) {
+            cout << "  Rewritten: " << rewritten << " (unchanged pages skipped)\n";
+        }
+        if (opt.archive) cout << "  Archive: " << outdir << Archive::file << " (index in " << outdir << Archive::file << ".idx)\n";
+        else cout << "  Open " << outdir << "/index.html in your browser\n";
+        if (opt.stats) Stats::report(cout);
+        if (!opt.trace.empty()) Stats::saveTrace(opt.trace);
         
-        cout << "✓ SDOC documentation generated successfully!\n";
-        cout << "  Output directory: " << outdir << "/\n";
-        cout << "  Total pages: " << defs.size() + 1 << " (" << defs.size() << " detail pages + 1 index)\n";
-        cout << "  Open " << outdir << "/index.html in your browser\n";
-        
+        if (opt.watch) watchInputs(args, corpus, opt, style, outdir, manifest, pool);
     } catch (const exception& e) {
         cerr << "Error: " << e.what() << "\n";
         return 1;
@@ -730,3 +4520,4 @@ int main(int argc, char **argv) {
     
     return 0;
 }
+#endif